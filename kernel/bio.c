@@ -1,6 +1,6 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
@@ -23,75 +23,262 @@
 #include "fs.h"
 #include "buf.h"
 
+// The buffers are spread over NBUCKET hash buckets keyed by
+// block number, each a list with its own lock, so that
+// lookups of different blocks do not contend. Each bucket also
+// keeps its unused buffers (refcnt 0) on an LRU list, least
+// recently released first. A miss recycles the head of its own
+// bucket's LRU list, or, if that is empty, of the next bucket
+// along that has one, so no lock covers the whole cache. Only one
+// bucket lock is held at a time; a process that finds, once it
+// has a buffer, that another process has meanwhile added the same
+// block uses that one instead, and gives its own back.
+//
+// A buffer whose dev is 0 holds no block: binit() starts every
+// buffer that way, and a buffer given back after such a race
+// goes back to it.
+//
+// The number of buffers is chosen at boot: enough for their
+// data to take a 1/BFRAC share of free memory, but no fewer than
+// NBUF. The headers and the data come from separate pages.
+// File data is cached by the page cache (pcache.c), which reads
+// it from the disk itself, so the buffers hold metadata, and file
+// blocks only while they are being written.
+#define NBUCKET 251
+#define BFRAC   32
+
 struct {
-  struct spinlock lock;
-  struct buf buf[NBUF];
+  int nbuf;
 
-  // Linked list of all buffers, through prev/next.
-  // Sorted by how recently the buffer was used.
-  // head.next is most recent, head.prev is least.
-  struct buf head;
+  struct {
+    struct spinlock lock;
+    struct buf *head;
+    struct buf *lru;       // unused buffers, least recently used first
+    struct buf *lrutail;
+  } bucket[NBUCKET];
 } bcache;
 
+static int
+bhash(uint dev, uint blockno)
+{
+  return blockno % NBUCKET;
+}
+
+// Insert b at the front of bucket h. Caller must hold its lock.
+static void
+binsert(int h, struct buf *b)
+{
+  b->prev = 0;
+  b->next = bcache.bucket[h].head;
+  if(b->next)
+    b->next->prev = b;
+  bcache.bucket[h].head = b;
+}
+
+// Remove b from bucket h. Caller must hold its lock.
+static void
+bremove(int h, struct buf *b)
+{
+  if(b->prev)
+    b->prev->next = b->next;
+  else
+    bcache.bucket[h].head = b->next;
+  if(b->next)
+    b->next->prev = b->prev;
+}
+
+// Append b, which has just become unused, to the LRU list of
+// bucket h. Caller must hold its lock.
+static void
+lruappend(int h, struct buf *b)
+{
+  b->lnext = 0;
+  b->lprev = bcache.bucket[h].lrutail;
+  if(b->lprev)
+    b->lprev->lnext = b;
+  else
+    bcache.bucket[h].lru = b;
+  bcache.bucket[h].lrutail = b;
+}
+
+// Remove b from the LRU list of bucket h.
+// Caller must hold its lock.
+static void
+lruremove(int h, struct buf *b)
+{
+  if(b->lprev)
+    b->lprev->lnext = b->lnext;
+  else
+    bcache.bucket[h].lru = b->lnext;
+  if(b->lnext)
+    b->lnext->lprev = b->lprev;
+  else
+    bcache.bucket[h].lrutail = b->lprev;
+}
+
+// Take a reference to b, in bucket h, taking it off the LRU list
+// if it was unused. Caller must hold the bucket's lock.
+static void
+bhold(int h, struct buf *b)
+{
+  if(b->refcnt++ == 0)
+    lruremove(h, b);
+}
+
+// Drop a reference to b, in bucket h, putting it on the LRU list
+// if it is now unused. Caller must hold the bucket's lock.
+static void
+bdrop(int h, struct buf *b)
+{
+  if(b->refcnt == 0)
+    panic("bdrop");
+  if(--b->refcnt == 0)
+    lruappend(h, b);
+}
 
 // 初始化磁盘缓存
-// 这里本质上就是一个双向链表
 void
 binit(void)
 {
   struct buf *b;
+  uchar *data;
+  int i, n;
 
-  // 初始化磁盘缓存块锁
-  initlock(&bcache.lock, "bcache");
-
-  // Create linked list of buffers
-  // 如下创建缓存的双向链表
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next; // 将所有的buf插入双向链表当中
-    b->prev = &bcache.head;
-    initsleeplock(&b->lock, "buffer"); // 获取buff锁
-    bcache.head.next->prev = b; // 修改头节点对应的指针
-    bcache.head.next = b;
+  for(i = 0; i < NBUCKET; i++)
+    initlock(&bcache.bucket[i].lock, "bcache.bucket");
+
+  n = kfreepages() / BFRAC * (PGSIZE / BSIZE);
+  if(n < NBUF)
+    n = NBUF;
+
+  // Spread the buffers over the buckets to start with; misses
+  // move them to the bucket of the block they are given.
+  b = 0;
+  data = 0;
+  for(i = 0; i < n; i++){
+    if(i % (PGSIZE / sizeof(struct buf)) == 0){
+      if((b = kalloc()) == 0)
+        panic("binit");
+      memset(b, 0, PGSIZE);
+    }
+    if(i % (PGSIZE / BSIZE) == 0 && (data = kalloc()) == 0)
+      panic("binit");
+    b->data = data + i % (PGSIZE / BSIZE) * BSIZE;
+    initsleeplock(&b->lock, "buffer");
+    binsert(i % NBUCKET, b);
+    lruappend(i % NBUCKET, b);
+    b++;
+  }
+  bcache.nbuf = n;
+}
+
+// Look for block on device dev in bucket h.
+// Caller must hold the bucket's lock.
+static struct buf*
+bfind(int h, uint dev, uint blockno)
+{
+  struct buf *b;
+
+  for(b = bcache.bucket[h].head; b; b = b->next)
+    if(b->dev == dev && b->blockno == blockno)
+      return b;
+  return 0;
+}
+
+// Take the least recently used unused buffer of bucket h, or of
+// the first bucket after it that has one, out of the cache.
+// Returns it with one reference and no block, or 0 if every
+// buffer is in use.
+static struct buf*
+brecycle(int h)
+{
+  struct buf *b;
+  int i, v;
+
+  for(i = 0; i < NBUCKET; i++){
+    v = (h + i) % NBUCKET;
+    // an unlocked look saves locking buckets with nothing to give.
+    if(bcache.bucket[v].lru == 0)
+      continue;
+    acquire(&bcache.bucket[v].lock);
+    if((b = bcache.bucket[v].lru) != 0){
+      lruremove(v, b);
+      bremove(v, b);
+      b->refcnt = 1;
+      b->dev = 0;
+      b->valid = 0;
+      release(&bcache.bucket[v].lock);
+      return b;
+    }
+    release(&bcache.bucket[v].lock);
   }
+  return 0;
 }
 
 // Look through buffer cache for block on device dev.
 // If not found, allocate a buffer.
 // In either case, return locked buffer.
-// 这里相当于先找到一个磁盘缓存块, 但是当前块是不合法的, 也就是需要后期调入内存
 static struct buf*
 bget(uint dev, uint blockno)
 {
-  struct buf *b;
+  struct buf *b, *nb;
+  int h;
 
-  acquire(&bcache.lock);
+  h = bhash(dev, blockno);
+  acquire(&bcache.bucket[h].lock);
+  if((b = bfind(h, dev, blockno)) != 0){
+    bhold(h, b);
+    release(&bcache.bucket[h].lock);
+    acquiresleep(&b->lock);
+    return b;
+  }
+  release(&bcache.bucket[h].lock);
 
-  // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
-    if(b->dev == dev && b->blockno == blockno){
-      b->refcnt++;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
+  if((nb = brecycle(h)) == 0)
+    panic("bget: no buffers");
+
+  // look again, in case another process added the block while
+  // no lock was held; if so, give the recycled buffer back.
+  acquire(&bcache.bucket[h].lock);
+  if((b = bfind(h, dev, blockno)) != 0){
+    binsert(h, nb);
+    bdrop(h, nb);
+    bhold(h, b);
+  } else {
+    b = nb;
+    b->dev = dev;
+    b->blockno = blockno;
+    binsert(h, b);
   }
+  release(&bcache.bucket[h].lock);
+  acquiresleep(&b->lock);
+  return b;
+}
 
-  // Not cached.
-  // Recycle the least recently used (LRU) unused buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
+// If block blockno of dev is in the cache, copy it to dst and
+// return 1; otherwise return 0, without reading the disk.
+// The page cache uses this to find file blocks that have been
+// written through the log but not yet installed on disk.
+int
+bpeek(uint dev, uint blockno, char *dst)
+{
+  struct buf *b;
+  int h, r;
+
+  h = bhash(dev, blockno);
+  acquire(&bcache.bucket[h].lock);
+  if((b = bfind(h, dev, blockno)) == 0){
+    release(&bcache.bucket[h].lock);
+    return 0;
   }
-  panic("bget: no buffers");
+  bhold(h, b);
+  release(&bcache.bucket[h].lock);
+
+  acquiresleep(&b->lock);
+  if((r = b->valid) != 0)
+    memmove(dst, b->data, BSIZE);
+  brelse(b);
+  return r;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -109,6 +296,18 @@ bread(uint dev, uint blockno)
   return b;
 }
 
+// Return a locked buf for a block that the caller is going to
+// overwrite completely, without reading it from disk.
+struct buf*
+bgetnoread(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno);
+  b->valid = 1;
+  return b;
+}
+
 // Write b's contents to disk.  Must be locked.
 void
 bwrite(struct buf *b)
@@ -118,43 +317,56 @@ bwrite(struct buf *b)
   virtio_disk_rw(b, 1);
 }
 
+// Start writing b's contents to disk without waiting, so that
+// several writes can be in flight at once. b must stay locked
+// until bwait(b) returns.
+void
+bstartwrite(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("bstartwrite");
+  virtio_disk_submit(b, 1);
+}
+
+// Wait for a write started by bstartwrite().
+void
+bwait(struct buf *b)
+{
+  virtio_disk_wait(b);
+}
+
 // Release a locked buffer.
-// Move to the head of the most-recently-used list.
+// An unused buffer goes to the tail of its bucket's LRU list.
 void
 brelse(struct buf *b)
 {
+  int h;
+
   if(!holdingsleep(&b->lock))
     panic("brelse");
 
   releasesleep(&b->lock);
 
-  acquire(&bcache.lock);
-  b->refcnt--;
-  if (b->refcnt == 0) {
-    // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
-  }
-  
-  release(&bcache.lock);
+  h = bhash(b->dev, b->blockno);
+  acquire(&bcache.bucket[h].lock);
+  bdrop(h, b);
+  release(&bcache.bucket[h].lock);
 }
 
 void
 bpin(struct buf *b) {
-  acquire(&bcache.lock);
-  b->refcnt++;
-  release(&bcache.lock);
+  int h = bhash(b->dev, b->blockno);
+
+  acquire(&bcache.bucket[h].lock);
+  bhold(h, b);
+  release(&bcache.bucket[h].lock);
 }
 
 void
 bunpin(struct buf *b) {
-  acquire(&bcache.lock);
-  b->refcnt--;
-  release(&bcache.lock);
-}
-
+  int h = bhash(b->dev, b->blockno);
 
+  acquire(&bcache.bucket[h].lock);
+  bdrop(h, b);
+  release(&bcache.bucket[h].lock);
+}
@@ -1,12 +1,16 @@
 struct buf {
   int valid;   // has data been read from disk?
   int disk;    // does disk "own" buf?
+  void (*end_io)(struct buf *);  // if set, called when an async request completes
+  void *priv;  // for end_io's use
   uint dev;
   uint blockno;
   struct sleeplock lock;
   uint refcnt;
-  struct buf *prev; // LRU cache list
+  struct buf *prev; // bcache hash bucket list
   struct buf *next;
-  uchar data[BSIZE];
+  struct buf *lprev; // bucket's LRU list, while refcnt is 0
+  struct buf *lnext;
+  uchar *data; // BSIZE bytes; the page cache points it into its own pages
 };
 
@@ -0,0 +1,163 @@
+//
+// Directory entry cache: remembers what looking up a name in a
+// directory found, so that namex() can walk cached path
+// components without locking each directory and reading its
+// blocks.
+//
+// An entry maps (dev, directory inum, name) to the inum the name
+// refers to, or to 0 for a name known not to exist (a negative
+// entry). The cache is NDBUCKET sets of NDWAY entries, each set
+// with its own lock; a new entry replaces the least recently used
+// one in its set.
+//
+// Entries are added and changed only by holders of the
+// directory's sleep-lock: after a dirlookup() in namex(), and
+// by dirlink() and unlink as they change the directory. A
+// lookup takes only the set's lock, and gets its reference to
+// the inode (with iget()) while still holding it, so that a
+// concurrent unlink, which must update the entry first, cannot
+// free the inode before the reference is taken. When a directory
+// inode is freed, its entries are purged so that they cannot
+// apply to a later directory with the same inum.
+//
+// Lock order: a dcache set lock, then the inode table locks.
+//
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "fs.h"
+#include "file.h"
+
+#define NDBUCKET 128
+#define NDWAY    8
+
+struct dentry {
+  uint dev;
+  uint dinum;          // directory's inum; 0 if the entry is free
+  char name[DIRSIZ];
+  uint inum;           // what name refers to; 0 if it doesn't exist
+  uint used;           // when last looked up, for LRU
+};
+
+struct {
+  struct {
+    struct spinlock lock;
+    struct dentry e[NDWAY];
+  } set[NDBUCKET];
+  uint clock;          // for used stamps; races are harmless
+  uint hits;
+  uint misses;
+} dcache;
+
+static uint
+dhash(uint dev, uint dinum, char *name)
+{
+  uint h;
+  int i;
+
+  h = dev * 31 + dinum;
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = h * 31 + (uchar)name[i];
+  return h % NDBUCKET;
+}
+
+void
+dcacheinit(void)
+{
+  int i;
+
+  for(i = 0; i < NDBUCKET; i++)
+    initlock(&dcache.set[i].lock, "dcache");
+}
+
+// Look up name in directory dp. Returns 1 if the cache knows the
+// answer, setting *ipp to the referenced inode (from iget()) or
+// to 0 if name doesn't exist; returns 0 if it doesn't know.
+// Does not lock dp.
+int
+dcachelookup(struct inode *dp, char *name, struct inode **ipp)
+{
+  struct dentry *e;
+  int h, i;
+
+  h = dhash(dp->dev, dp->inum, name);
+  acquire(&dcache.set[h].lock);
+  for(i = 0; i < NDWAY; i++){
+    e = &dcache.set[h].e[i];
+    if(e->dinum == dp->inum && e->dev == dp->dev &&
+       namecmp(e->name, name) == 0){
+      e->used = ++dcache.clock;
+      *ipp = e->inum ? iget(dp->dev, e->inum) : 0;
+      dcache.hits++;
+      release(&dcache.set[h].lock);
+      return 1;
+    }
+  }
+  dcache.misses++;
+  release(&dcache.set[h].lock);
+  return 0;
+}
+
+// Record that name in directory dp refers to inum, or
+// doesn't exist if inum is 0.
+// Caller must hold dp->lock.
+void
+dcacheput(struct inode *dp, char *name, uint inum)
+{
+  struct dentry *e, *victim;
+  int h, i;
+
+  h = dhash(dp->dev, dp->inum, name);
+  acquire(&dcache.set[h].lock);
+  victim = 0;
+  for(i = 0; i < NDWAY; i++){
+    e = &dcache.set[h].e[i];
+    if(e->dinum == dp->inum && e->dev == dp->dev &&
+       namecmp(e->name, name) == 0){
+      victim = e;
+      break;
+    }
+    if(victim == 0 || e->dinum == 0 ||
+       (victim->dinum != 0 && e->used < victim->used))
+      victim = e;
+  }
+  victim->dev = dp->dev;
+  victim->dinum = dp->inum;
+  strncpy(victim->name, name, DIRSIZ);
+  victim->inum = inum;
+  victim->used = ++dcache.clock;
+  release(&dcache.set[h].lock);
+}
+
+// Drop every entry for directory inum on dev, which is being freed.
+void
+dcachepurge(uint dev, uint inum)
+{
+  struct dentry *e;
+  int h, i;
+
+  for(h = 0; h < NDBUCKET; h++){
+    acquire(&dcache.set[h].lock);
+    for(i = 0; i < NDWAY; i++){
+      e = &dcache.set[h].e[i];
+      if(e->dinum == inum && e->dev == dev)
+        e->dinum = 0;
+    }
+    release(&dcache.set[h].lock);
+  }
+}
+
+// Append the hit and miss counts to the statistics report.
+int
+dcachestats(char *buf, int sz)
+{
+  int n;
+
+  n = snprintf(buf, sz, "--- dcache stats\ndcache: hits %d misses %d\n",
+               dcache.hits, dcache.misses);
+  return n < sz ? n : sz - 1;
+}
@@ -7,13 +7,18 @@ struct proc;
 struct spinlock;
 struct sleeplock;
 struct stat;
+struct vma;
 struct superblock;
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
+struct buf*     bgetnoread(uint, uint);
+int             bpeek(uint, uint, char*);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            bstartwrite(struct buf*);
+void            bwait(struct buf*);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
 
@@ -34,12 +39,21 @@ int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
 
+// dcache.c
+void            dcacheinit(void);
+int             dcachelookup(struct inode*, char*, struct inode**);
+void            dcacheput(struct inode*, char*, uint);
+void            dcachepurge(uint, uint);
+int             dcachestats(char*, int);
+
 // fs.c
 void            fsinit(int);
+uint            bmap(struct inode*, uint);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
+struct inode*   iget(uint, uint);
 void            iinit();
 void            ilock(struct inode*);
 void            iput(struct inode*);
@@ -50,9 +64,10 @@ int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, int, uint64, uint, uint);
+void            readahead(struct inode*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
-void            itrunc(struct inode*);
+int             itrunc(struct inode*);
 
 // ramdisk.c
 void            ramdiskinit(void);
@@ -62,13 +77,30 @@ void            ramdiskrw(struct buf*);
 // kalloc.c
 void*           kalloc(void);
 void            kfree(void *);
+int             kput(void *);
 void            kinit(void);
+int             kfreepages(void);
+void            krefinc(void *);
+int             krefcnt(void *);
 
 // log.c
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
 void            begin_op(void);
+void            begin_opn(int);
 void            end_op(void);
+void            end_opn(int);
+int             log_opmax(void);
+
+// pcache.c
+struct pcpage;
+void            pcacheinit(void);
+struct pcpage*  pcacheget(struct inode*, uint);
+void            pcacheput(struct pcpage*);
+void            pcacheahead(struct inode*, uint, uint);
+void            pcachewrite(struct inode*, uint, char*, uint);
+void            pcacheinval(struct inode*);
+int             pcachereclaim(int);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
@@ -90,6 +122,7 @@ void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kill(int);
+void            kthread(char*, void (*)(void));
 int             killed(struct proc*);
 void            setkilled(struct proc*);
 struct cpu*     mycpu(void);
@@ -106,17 +139,26 @@ void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+int             idlestats(char*, int);
+int             needresched(void);
+uint64          chargeslice(void);
+int             nice(int, int);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
 
+// sprintf.c
+int             snprintf(char*, int, char*, ...);
+
 // spinlock.c
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+void            freelock(struct spinlock*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
+int             statslock(char*, int);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
@@ -124,6 +166,9 @@ void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
+// stats.c
+void            statsinit(void);
+
 // string.c
 int             memcmp(const void*, const void*, uint);
 void*           memmove(void*, const void*, uint);
@@ -141,11 +186,25 @@ int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
 
+// text.c
+void            textinit(void);
+char*           textget(struct inode*, uint, uint);
+void            textput(char*);
+void            textinval(struct inode*);
+
+// timer.c
+void            timersinit(void);
+void            timerslice(uint64);
+uint            tickcount(void);
+uint64          timens(void);
+int             timernanosleep(uint64);
+int             timersleep(uint64);
+int             timerintr(void);
+int             timerstats(char*, int);
+
 // trap.c
-extern uint     ticks;
 void            trapinit(void);
 void            trapinithart(void);
-extern struct spinlock tickslock;
 void            usertrapret(void);
 
 // uart.c
@@ -165,6 +224,9 @@ void            uvmfirst(pagetable_t, uchar *, uint);
 uint64          uvmalloc(pagetable_t, uint64, uint64, int);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
+uint64          uvmcow(pagetable_t, uint64);
+uint64          vmfault(pagetable_t, uint64, int);
+void            uvmprefault(pagetable_t, uint64, uint64, int);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
@@ -174,6 +236,17 @@ int             copyout(pagetable_t, uint64, char *, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
 
+// vma.c
+void            vmainit(void);
+struct vma*     vmalookup(struct vma*, uint64);
+void            vmatext(struct vma*, struct inode*);
+uint64          vmaload(pagetable_t, struct vma*, uint64, int);
+uint64          vmamap(uint64, int, int, struct inode*, uint);
+int             vmaunmap(uint64, uint64);
+int             vmacopy(pagetable_t, pagetable_t, struct vma*);
+void            vmadup(struct vma*, struct vma*);
+void            vmaput(pagetable_t, struct vma*);
+
 // plic.c
 void            plicinit(void);
 void            plicinithart(void);
@@ -183,6 +256,8 @@ void            plic_complete(int);
 // virtio_disk.c
 void            virtio_disk_init(void);
 void            virtio_disk_rw(struct buf *, int);
+void            virtio_disk_submit(struct buf *, int);
+void            virtio_disk_wait(struct buf *);
 void            virtio_disk_intr(void);
 
 // number of elements in fixed-size array
@@ -7,8 +7,6 @@
 #include "defs.h"
 #include "elf.h"
 
-static int loadseg(pde_t *, uint64, struct inode *, uint, uint);
-
 int flags2perm(int flags)
 {
     int perm = 0;
@@ -31,9 +29,12 @@ exec(char *path, char **argv)
   struct elfhdr elf;
   struct inode *ip;
   struct proghdr ph;
+  struct vma vma[NVMA], *v;
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
 
+  memset(vma, 0, sizeof(vma));
+
   begin_op();
 
   // 获取路径path对应的inode
@@ -56,8 +57,10 @@ exec(char *path, char **argv)
   if((pagetable = proc_pagetable(p)) == 0)
     goto bad;
 
-  // Load program into memory.
+  // Record where each segment lives in the file; its pages are
+  // read in by vmaload() when the program first touches them.
   // 将程序载入内存当中, 这里程序需要满足elf文件的标准格式
+  v = vma;
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, 0, (uint64)&ph, off, sizeof(ph)) != sizeof(ph))
       goto bad;
@@ -69,14 +72,29 @@ exec(char *path, char **argv)
       goto bad;
     if(ph.vaddr % PGSIZE != 0)
       goto bad;
-    uint64 sz1;
-    if((sz1 = uvmalloc(pagetable, sz, ph.vaddr + ph.memsz, flags2perm(ph.flags))) == 0)
+    if(ph.vaddr < sz)
       goto bad;
-    // sz中保存的值就是整个内存最大的合法虚拟地址
-    sz = sz1;
-    if(loadseg(pagetable, ph.vaddr, ip, ph.off, ph.filesz) < 0)
+    if(ph.memsz == 0)
+      continue;
+    if(v == vma + NVMA)
       goto bad;
+    v->start = ph.vaddr;
+    v->end = ph.vaddr + ph.memsz;
+    vmatext(v, ip);
+    v->off = ph.off;
+    v->filesz = ph.filesz;
+    v->perm = PTE_R | flags2perm(ph.flags);
+    v++;
+    // sz中保存的值就是整个内存最大的合法虚拟地址
+    sz = ph.vaddr + ph.memsz;
   }
+
+  // The page holding the entry point is certain to be needed,
+  // so read it now while the inode is locked.
+  if((v = vmalookup(vma, elf.entry)) == 0)
+    goto bad;
+  if(vmaload(pagetable, v, elf.entry, 0) == 0)
+    goto bad;
   iunlockput(ip);
   end_op();
   ip = 0;
@@ -143,6 +161,8 @@ exec(char *path, char **argv)
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
+  vmaput(oldpagetable, p->vma);
+  memmove(p->vma, vma, sizeof(vma));
   // 释放原本进程的页表
   proc_freepagetable(oldpagetable, oldsz);
 
@@ -155,31 +175,6 @@ exec(char *path, char **argv)
     iunlockput(ip);
     end_op();
   }
+  vmaput(0, vma);
   return -1;
 }
-
-// Load a program segment into pagetable at virtual address va.
-// va must be page-aligned
-// and the pages from va to va+sz must already be mapped.
-// Returns 0 on success, -1 on failure.
-// 将程序段载入到页表va对应的虚拟地址中
-static int
-loadseg(pagetable_t pagetable, uint64 va, struct inode *ip, uint offset, uint sz)
-{
-  uint i, n;
-  uint64 pa;
-
-  for(i = 0; i < sz; i += PGSIZE){
-    pa = walkaddr(pagetable, va + i);
-    if(pa == 0)
-      panic("loadseg: address should exist");
-    if(sz - i < PGSIZE)
-      n = sz - i;
-    else
-      n = PGSIZE;
-    if(readi(ip, 0, (uint64)pa, offset+i, n) != n)
-      return -1;
-  }
-  
-  return 0;
-}
@@ -13,6 +13,9 @@
 #include "stat.h"
 #include "proc.h"
 
+#define RAMIN 4   // first readahead window, in blocks
+#define RAMAX 32  // largest readahead window
+
 struct devsw devsw[NDEV];
 // filetable中实际上存储了所有的file, 一个萝卜一个坑, 实现把坑都占好了
 struct {
@@ -104,6 +107,39 @@ filestat(struct file *f, uint64 addr)
   return -1;
 }
 
+// Sequential readahead. A read that starts where the previous
+// one ended doubles the readahead window, up to RAMAX blocks;
+// any other read turns readahead off until reads are sequential
+// again. After a sequential read of [off, off+n), start reading
+// the window's worth of blocks that follow, skipping those
+// already started. Caller must hold f->ip->lock.
+static void
+fileahead(struct file *f, uint off, int n)
+{
+  uint start, end;
+
+  if(off != f->ranext){
+    f->rawin = 0;
+    f->raend = 0;
+    f->ranext = off + n;
+    return;
+  }
+  f->ranext = off + n;
+  if(f->rawin == 0)
+    f->rawin = RAMIN;
+  else if(f->rawin < RAMAX)
+    f->rawin *= 2;
+
+  start = off + n;
+  if(f->raend > start)
+    start = f->raend;
+  end = off + n + f->rawin*BSIZE;
+  if(start < end){
+    readahead(f->ip, start, end - start);
+    f->raend = end;
+  }
+}
+
 // Read from file f.
 // addr is a user virtual address.
 // f是对file的抽象, addr是用户空间地址
@@ -111,6 +147,7 @@ int
 fileread(struct file *f, uint64 addr, int n)
 {
   int r = 0;
+  uint m;
 
   if(f->readable == 0)
     return -1;
@@ -124,10 +161,20 @@ fileread(struct file *f, uint64 addr, int n)
     r = devsw[f->major].read(1, addr, n);
   } else if(f->type == FD_INODE){ // 如果读INODE
     //这里相当于就是读取inode
+    // fault the buffer in first: vmaload() takes the lock of the
+    // file behind a page, and two processes each reading one file
+    // into pages of the other's would deadlock. only the part the
+    // file can fill, so as not to allocate a huge lazy buffer;
+    // open() has read the inode, so its size can be looked at
+    // without the lock.
+    m = f->off < f->ip->size ? f->ip->size - f->off : 0;
+    uvmprefault(myproc()->pagetable, addr, n < m ? n : m, 1);
     ilock(f->ip);
     // 读取inode内容到对应的地址, 这里指定inode, 是否用户空间, addr, 偏置
-    if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
+    if((r = readi(f->ip, 1, addr, f->off, n)) > 0){
+      fileahead(f, f->off, r);
       f->off += r; // 设置文件读取的偏置
+    }
     iunlock(f->ip);
   } else {
     panic("fileread");
@@ -159,19 +206,22 @@ filewrite(struct file *f, uint64 addr, int n)
     // and 2 blocks of slop for non-aligned writes.
     // this really belongs lower down, since writei()
     // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+    int opmax = log_opmax();
+    int max = ((opmax-1-1-2) / 2) * BSIZE;
     int i = 0;
     while(i < n){
       int n1 = n - i;
       if(n1 > max)
         n1 = max;
 
-      begin_op();
+      // fault the data in before locking, as fileread() does.
+      uvmprefault(myproc()->pagetable, addr + i, n1, 0);
+      begin_opn(opmax);
       ilock(f->ip);
       if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
         f->off += r;
       iunlock(f->ip);
-      end_op();
+      end_opn(opmax);
 
       if(r != n1){
         // error from writei
@@ -6,6 +6,9 @@ struct file {
   struct pipe *pipe; // FD_PIPE, 根据文件的类型设置其对应的底层数据结构
   struct inode *ip;  // FD_INODE and FD_DEVICE
   uint off;          // FD_INODE
+  uint ranext;       // FD_INODE: offset a sequential read would start at
+  uint raend;        // FD_INODE: readahead has been started up to here
+  uint rawin;        // FD_INODE: readahead window, in blocks
   short major;       // FD_DEVICE
 };
 
@@ -19,6 +22,11 @@ struct inode {
   uint dev;           // Device number, 设备号
   uint inum;          // Inode number, inode的标识号
   int ref;            // Reference count, 引用数目
+  int nexec;          // exec() areas mapping it; changed atomically
+  struct inode *next; // hash chain, protected by the bucket's lock
+  struct inode *prev;
+  struct inode *lnext; // LRU list of unreferenced inodes, protected by itable.lru
+  struct inode *lprev;
   struct sleeplock lock; // protects everything below here, 对应的休眠锁
   int valid;          // inode has been read from disk? 是否已经从磁盘中读取
 
@@ -27,7 +35,10 @@ struct inode {
   short minor;
   short nlink;
   uint size;
-  uint addrs[NDIRECT+1];
+  struct extent ext[NEXTENT];
+  uint xblock;
+
+  struct pcpage *pages;  // cached file pages; protected by pcache.lock
 };
 
 // map major device number to device functions.
@@ -42,3 +53,4 @@ struct devsw {
 extern struct devsw devsw[];
 
 #define CONSOLE 1
+#define STATS   2
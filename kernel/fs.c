@@ -20,6 +20,7 @@
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
+#include "pcache.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 // there should be one superblock per disk device, but we run with
@@ -37,6 +38,43 @@ readsb(int dev, struct superblock *sb)
   brelse(bp);
 }
 
+// Free space summary: the number of free blocks covered by
+// each bitmap block, counted by fsinit(), so that ballocn()
+// can pass over bitmap blocks with too little room without
+// reading them. The bitmap is the authority; a count changes
+// only while its bitmap block is locked.
+struct {
+  struct spinlock lock;
+  int nbmap;     // number of bitmap blocks
+  uint *nfree;   // free blocks per bitmap block
+} fsfree;
+
+// Count the free blocks in each bitmap block.
+static void
+bsummary(int dev)
+{
+  struct buf *bp;
+  uint b;
+  int i, bi;
+
+  initlock(&fsfree.lock, "fsfree");
+  fsfree.nbmap = (sb.size + BPB - 1) / BPB;
+  if(fsfree.nbmap > PGSIZE / sizeof(uint))
+    panic("bsummary: disk too big");
+  if((fsfree.nfree = (uint*)kalloc()) == 0)
+    panic("bsummary: kalloc");
+  for(i = 0; i < fsfree.nbmap; i++){
+    b = i * BPB;
+    bp = bread(dev, BBLOCK(b, sb));
+    fsfree.nfree[i] = 0;
+    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
+      if((bp->data[bi/8] & (1 << (bi % 8))) == 0)
+        fsfree.nfree[i]++;
+    }
+    brelse(bp);
+  }
+}
+
 // Init fs
 void
 fsinit(int dev) {
@@ -44,6 +82,7 @@ fsinit(int dev) {
   if(sb.magic != FSMAGIC)
     panic("invalid file system");
   initlog(dev, &sb);
+  bsummary(dev);
 }
 
 // Zero a block.
@@ -53,7 +92,8 @@ bzero(int dev, int bno)
 {
   struct buf *bp;
 
-  bp = bread(dev, bno);
+  // The old contents don't matter, so don't read them.
+  bp = bgetnoread(dev, bno);
   memset(bp->data, 0, BSIZE);
   log_write(bp);
   brelse(bp);
@@ -61,52 +101,142 @@ bzero(int dev, int bno)
 
 // Blocks.
 
-// Allocate a zeroed disk block.
+// Return the length, up to max, of the run of free blocks
+// at bit bi of bitmap block bp, which covers blocks from b.
+static int
+brun(struct buf *bp, uint b, int bi, int max)
+{
+  int n;
+
+  for(n = 0; n < max && bi + n < BPB && b + bi + n < sb.size; n++){
+    if(bp->data[(bi+n)/8] & (1 << ((bi+n) % 8)))
+      break;
+  }
+  return n;
+}
+
+// Return the first bit at or after bi of bitmap block bp that
+// starts a run of at least want free blocks, or -1.
+static int
+bfind(struct buf *bp, uint b, int bi, int want)
+{
+  int n;
+
+  while(bi < BPB && b + bi < sb.size){
+    if(bi % 8 == 0 && bp->data[bi/8] == 0xff){
+      bi += 8;  // skip 8 blocks in use
+      continue;
+    }
+    if((n = brun(bp, b, bi, want)) >= want)
+      return bi;
+    bi += n + 1;
+  }
+  return -1;
+}
+
+// Mark the n free blocks at bit bi of locked bitmap block bp in
+// use, release bp, and zero the blocks. Returns the first block.
+static uint
+btake(uint dev, struct buf *bp, uint b, int bi, int n)
+{
+  int i;
+
+  for(i = bi; i < bi + n; i++)
+    bp->data[i/8] |= 1 << (i % 8);  // Mark block in use.
+  acquire(&fsfree.lock);
+  fsfree.nfree[b / BPB] -= n;
+  release(&fsfree.lock);
+  log_write(bp);
+  brelse(bp);
+  for(i = 0; i < n; i++)
+    bzero(dev, b + bi + i);
+  return b + bi;
+}
+
+// Allocate a run of up to n zeroed disk blocks near goal.
+// If goal is free the run starts there, so a file can grow in
+// place. Otherwise ballocn() takes the first run of n free blocks
+// after goal, or failing that the first run of n/2, n/4, and so
+// on, wrapping around to the start of the disk. A run never spans
+// two bitmap blocks. Returns the first block and sets *got to the
+// run's length.
 // returns 0 if out of disk space.
-// 分配一个磁盘块
+// 分配连续的磁盘块
 static uint
-balloc(uint dev)
+ballocn(uint dev, uint goal, uint n, uint *got)
 {
-  int b, bi, m;
   struct buf *bp;
+  int i, k, bi, want;
+  uint b, nfree;
 
-  bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
-    // 这里实际上是将free map block块读入内存, 因为我要分配块了, 因此我需要记录这些块的分配信息
-    // 所以遍历的过程实际上就是依次的将free map读入内存
-    bp = bread(dev, BBLOCK(b, sb));
-    // 对于每一个free map block
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8); // 获取对应的掩码
-      if((bp->data[bi/8] & m) == 0){  // Is block free?, 这里就是判断free map中是否是free的
-        bp->data[bi/8] |= m;  // Mark block in use. 找到了一个free block
-        log_write(bp); // 写日志
-        brelse(bp); // 释放块
-        bzero(dev, b + bi); // 将磁盘块中的内容重置
-        return b + bi; // 返回可用的磁盘块号
+  if(goal >= sb.size)
+    goal = 0;
+
+  b = goal - goal % BPB;
+  bp = bread(dev, BBLOCK(b, sb));
+  if((*got = brun(bp, b, goal % BPB, n)) > 0)
+    return btake(dev, bp, b, goal % BPB, *got);
+  brelse(bp);
+
+  for(want = n; want > 0; want /= 2){
+    // the last pass looks at the part of goal's bitmap block before goal.
+    for(k = 0; k <= fsfree.nbmap; k++){
+      i = (goal / BPB + k) % fsfree.nbmap;
+      acquire(&fsfree.lock);
+      nfree = fsfree.nfree[i];
+      release(&fsfree.lock);
+      if(nfree < want)
+        continue;
+      b = i * BPB;
+      bp = bread(dev, BBLOCK(b, sb));
+      if((bi = bfind(bp, b, k == 0 ? goal % BPB : 0, want)) >= 0){
+        *got = brun(bp, b, bi, n);
+        return btake(dev, bp, b, bi, *got);
       }
+      brelse(bp);
     }
-    brelse(bp);
   }
   printf("balloc: out of blocks\n");
   return 0;
 }
 
-// Free a disk block.
+// Allocate a zeroed disk block, near goal if possible.
+// returns 0 if out of disk space.
+static uint
+balloc(uint dev, uint goal)
+{
+  uint got;
+
+  return ballocn(dev, goal, 1, &got);
+}
+
+// Free n disk blocks starting at b.
 static void
-bfree(int dev, uint b)
+bfreen(int dev, uint b, uint n)
 {
   struct buf *bp;
   int bi, m;
+  uint end, nfree;
 
-  bp = bread(dev, BBLOCK(b, sb));
-  bi = b % BPB;
-  m = 1 << (bi % 8);
-  if((bp->data[bi/8] & m) == 0)
-    panic("freeing free block");
-  bp->data[bi/8] &= ~m;
-  log_write(bp);
-  brelse(bp);
+  end = b + n;
+  while(b < end){
+    bp = bread(dev, BBLOCK(b, sb));
+    nfree = 0;
+    do {
+      bi = b % BPB;
+      m = 1 << (bi % 8);
+      if((bp->data[bi/8] & m) == 0)
+        panic("freeing free block");
+      bp->data[bi/8] &= ~m;
+      b++;
+      nfree++;
+    } while(b < end && b % BPB != 0);
+    acquire(&fsfree.lock);
+    fsfree.nfree[(b - 1) / BPB] += nfree;
+    release(&fsfree.lock);
+    log_write(bp);
+    brelse(bp);
+  }
 }
 
 // Inodes.
@@ -169,36 +299,122 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The itable.lock spin-lock protects the allocation of itable
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold itable.lock while using any of those fields.
+// The in-memory inodes are kept in a hash table keyed by
+// (dev, inum), with a spin-lock per bucket. A bucket's lock
+// protects the chain and the ref, dev and inum of each inode on
+// it; one must hold it while using any of those fields.
+// Inodes whose ref falls to zero stay in the table, still valid,
+// on an LRU list, so that an inode that is opened again soon
+// needs no disk read and keeps its cached pages. A miss in iget()
+// recycles the least recently used of them. itable.evict
+// serializes misses so that two processes cannot both add the
+// same inode, and itable.lru protects the LRU list.
+// The table starts with NINODE inodes, taken from kalloc() a page
+// at a time, and grows by another page whenever every inode is
+// in use.
+//
+// Lock order: a bucket lock, then itable.lru.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
+#define NIBUCKET 127
+
 struct {
-  struct spinlock lock;
-  struct inode inode[NINODE];
+  struct spinlock evict;
+  struct spinlock lru;
+  struct inode *lruhead;   // most recently used
+  struct inode *lrutail;
+  int ninode;
+  struct {
+    struct spinlock lock;
+    struct inode *head;
+  } bucket[NIBUCKET];
 } itable;
 
+static int
+ihash(uint dev, uint inum)
+{
+  return (dev * 31 + inum) % NIBUCKET;
+}
+
+// Add ip to the LRU list, at the head if it may be used again
+// and at the tail if it is free. Caller must hold itable.lru.
+static void
+lruinsert(struct inode *ip, int head)
+{
+  if(head){
+    ip->lprev = 0;
+    ip->lnext = itable.lruhead;
+    if(itable.lruhead)
+      itable.lruhead->lprev = ip;
+    else
+      itable.lrutail = ip;
+    itable.lruhead = ip;
+  } else {
+    ip->lnext = 0;
+    ip->lprev = itable.lrutail;
+    if(itable.lrutail)
+      itable.lrutail->lnext = ip;
+    else
+      itable.lruhead = ip;
+    itable.lrutail = ip;
+  }
+}
+
+// Caller must hold itable.lru.
+static void
+lruremove(struct inode *ip)
+{
+  if(ip->lprev)
+    ip->lprev->lnext = ip->lnext;
+  else
+    itable.lruhead = ip->lnext;
+  if(ip->lnext)
+    ip->lnext->lprev = ip->lprev;
+  else
+    itable.lrutail = ip->lprev;
+  ip->lnext = ip->lprev = 0;
+}
+
+// Add a page of unused inodes to the table.
+static int
+igrow(void)
+{
+  struct inode *ip;
+  char *mem;
+  int i;
+
+  if((mem = kalloc()) == 0)
+    return -1;
+  memset(mem, 0, PGSIZE);
+  acquire(&itable.lru);
+  for(i = 0; i < PGSIZE / sizeof(struct inode); i++){
+    ip = (struct inode*)mem + i;
+    initsleeplock(&ip->lock, "inode");
+    lruinsert(ip, 0);
+    itable.ninode++;
+  }
+  release(&itable.lru);
+  return 0;
+}
 
 // inode初始化
 void
 iinit()
 {
-  int i = 0;
-  // 初始化itable锁
-  initlock(&itable.lock, "itable");
-  for(i = 0; i < NINODE; i++) {
-    // 初始化每一个inode对应的锁
-    initsleeplock(&itable.inode[i].lock, "inode");
-  }
+  int i;
+
+  initlock(&itable.evict, "itable.evict");
+  initlock(&itable.lru, "itable.lru");
+  for(i = 0; i < NIBUCKET; i++)
+    initlock(&itable.bucket[i].lock, "itable");
+  while(itable.ninode < NINODE)
+    if(igrow() < 0)
+      panic("iinit");
 }
 
-static struct inode* iget(uint dev, uint inum);
-
 // Allocate an inode on device dev.
 // Mark it as allocated by  giving it type type.
 // Returns an unlocked but allocated and referenced inode,
@@ -243,47 +459,119 @@ iupdate(struct inode *ip)
   dip->minor = ip->minor;
   dip->nlink = ip->nlink;
   dip->size = ip->size;
-  memmove(dip->addrs, ip->addrs, sizeof(ip->addrs));
+  memmove(dip->ext, ip->ext, sizeof(ip->ext));
+  dip->xblock = ip->xblock;
   log_write(bp);
   brelse(bp);
 }
 
-// Find the inode with number inum on device dev
-// and return the in-memory copy. Does not lock
-// the inode and does not read it from disk.
-// 从设备dev上读取inum对应的inode
+// Look for inode inum on device dev in bucket h, and take a
+// reference to it if it is there. Caller must hold the bucket's lock.
 static struct inode*
-iget(uint dev, uint inum)
+ifind(int h, uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip;
 
-  acquire(&itable.lock);
+  for(ip = itable.bucket[h].head; ip; ip = ip->next){
+    if(ip->dev == dev && ip->inum == inum){
+      if(ip->ref++ == 0){
+        acquire(&itable.lru);
+        lruremove(ip);
+        release(&itable.lru);
+      }
+      return ip;
+    }
+  }
+  return 0;
+}
 
-  // Is the inode already in the table?
-  empty = 0;
-  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
-      release(&itable.lock);
+// Take the least recently used unreferenced inode out of the
+// table, growing the table if there is none.
+// Caller must hold itable.evict.
+static struct inode*
+irecycle(void)
+{
+  struct inode *ip;
+  int h;
+
+  for(;;){
+    acquire(&itable.lru);
+    ip = itable.lrutail;
+    release(&itable.lru);
+    if(ip == 0){
+      if(igrow() < 0)
+        panic("iget: no inodes");
+      continue;
+    }
+
+    // ip's dev and inum can't change while we hold itable.evict,
+    // but it might be referenced again before we lock its bucket.
+    h = ihash(ip->dev, ip->inum);
+    acquire(&itable.bucket[h].lock);
+    if(ip->ref == 0){
+      acquire(&itable.lru);
+      lruremove(ip);
+      release(&itable.lru);
+      if(ip->inum){
+        if(ip->prev)
+          ip->prev->next = ip->next;
+        else
+          itable.bucket[h].head = ip->next;
+        if(ip->next)
+          ip->next->prev = ip->prev;
+      }
+      release(&itable.bucket[h].lock);
+      // no one can find ip now, so its pages can go.
+      pcacheinval(ip);
       return ip;
     }
-    // 可以理解empty是一个空的内存ip
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
+    release(&itable.bucket[h].lock);
   }
+}
 
-  // Recycle an inode entry.
-  if(empty == 0)
-    panic("iget: no inodes");
+// Find the inode with number inum on device dev
+// and return the in-memory copy. Does not lock
+// the inode and does not read it from disk.
+// 从设备dev上读取inum对应的inode
+struct inode*
+iget(uint dev, uint inum)
+{
+  struct inode *ip;
+  int h;
+
+  h = ihash(dev, inum);
+  acquire(&itable.bucket[h].lock);
+  ip = ifind(h, dev, inum);
+  release(&itable.bucket[h].lock);
+  if(ip)
+    return ip;
+
+  // Not cached. Look again while holding itable.evict,
+  // in case another process added it meanwhile.
+  acquire(&itable.evict);
+  acquire(&itable.bucket[h].lock);
+  ip = ifind(h, dev, inum);
+  release(&itable.bucket[h].lock);
+  if(ip){
+    release(&itable.evict);
+    return ip;
+  }
 
   // 这里相当于分配一个, 但是实际上真的inum对应的inode还没有被读取到内存中
   // 也就是说inode现在还在磁盘上, 真正读的时候, 才会被调入内存中
-  ip = empty;
+  ip = irecycle();
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0; // 因此这里的valid设置为0
-  release(&itable.lock);
+  acquire(&itable.bucket[h].lock);
+  ip->prev = 0;
+  ip->next = itable.bucket[h].head;
+  if(ip->next)
+    ip->next->prev = ip;
+  itable.bucket[h].head = ip;
+  release(&itable.bucket[h].lock);
+  release(&itable.evict);
 
   return ip;
 }
@@ -294,9 +582,12 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&itable.lock);
+  int h;
+
+  h = ihash(ip->dev, ip->inum);
+  acquire(&itable.bucket[h].lock);
   ip->ref++;
-  release(&itable.lock);
+  release(&itable.bucket[h].lock);
   return ip;
 }
 
@@ -326,7 +617,8 @@ ilock(struct inode *ip)
     ip->minor = dip->minor;
     ip->nlink = dip->nlink;
     ip->size = dip->size;
-    memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
+    memmove(ip->ext, dip->ext, sizeof(ip->ext));
+    ip->xblock = dip->xblock;
     brelse(bp);
     ip->valid = 1;
     if(ip->type == 0)
@@ -354,7 +646,10 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
-  acquire(&itable.lock);
+  int h;
+
+  h = ihash(ip->dev, ip->inum);
+  acquire(&itable.bucket[h].lock);
 
   if(ip->ref == 1 && ip->valid && ip->nlink == 0){
     // inode has no links and no other references: truncate and free.
@@ -363,20 +658,27 @@ iput(struct inode *ip)
     // so this acquiresleep() won't block (or deadlock).
     acquiresleep(&ip->lock);
 
-    release(&itable.lock);
+    release(&itable.bucket[h].lock);
 
     itrunc(ip);
+    if(ip->type == T_DIR)
+      dcachepurge(ip->dev, ip->inum);
     ip->type = 0;
     iupdate(ip);
     ip->valid = 0;
 
     releasesleep(&ip->lock);
 
-    acquire(&itable.lock);
+    acquire(&itable.bucket[h].lock);
   }
 
-  ip->ref--;
-  release(&itable.lock);
+  if(--ip->ref == 0){
+    // keep it cached; a freed inode is the first to be recycled.
+    acquire(&itable.lru);
+    lruinsert(ip, ip->valid);
+    release(&itable.lru);
+  }
+  release(&itable.bucket[h].lock);
 }
 
 // Common idiom: unlock, then put.
@@ -390,93 +692,195 @@ iunlockput(struct inode *ip)
 // Inode content
 //
 // The content (data) associated with each inode is stored
-// in blocks on the disk. The first NDIRECT block numbers
-// are listed in ip->addrs[].  The next NINDIRECT blocks are
-// listed in block ip->addrs[NDIRECT].
+// in runs of consecutive blocks on the disk, listed in order
+// by ip->ext[]. If a file has more than NEXTENT runs, the
+// rest are listed in block ip->xblock. Blocks are always added
+// at the end of a file, so the extents map blocks 0 up to some
+// count with no holes.
+
+// Return the disk address of the nth block of ip, or 0
+// if ip doesn't have that many blocks.
+static uint
+emap(struct inode *ip, uint bn)
+{
+  struct buf *bp;
+  struct extent *e;
+  uint addr;
+  int i;
+
+  for(i = 0; i < NEXTENT && ip->ext[i].len; i++){
+    if(bn < ip->ext[i].len)
+      return ip->ext[i].start + bn;
+    bn -= ip->ext[i].len;
+  }
+  if(ip->xblock == 0)
+    return 0;
 
-// Return the disk block address of the nth block in inode ip.
-// If there is no such block, bmap allocates one.
-// returns 0 if out of disk space.
+  bp = bread(ip->dev, ip->xblock);
+  e = (struct extent*)bp->data;
+  addr = 0;
+  for(i = 0; i < NXEXTENT && e[i].len; i++){
+    if(bn < e[i].len){
+      addr = e[i].start + bn;
+      break;
+    }
+    bn -= e[i].len;
+  }
+  brelse(bp);
+  return addr;
+}
 
-// 这个相当于inode内存存储数据的格式
-// NDIRECT + 1(4096 + 512 * 4096)
+// Return the number of blocks mapped by ip's extents.
+static uint
+iblocks(struct inode *ip)
+{
+  struct buf *bp;
+  struct extent *e;
+  uint n;
+  int i;
+
+  n = 0;
+  for(i = 0; i < NEXTENT; i++)
+    n += ip->ext[i].len;
+  if(ip->xblock){
+    bp = bread(ip->dev, ip->xblock);
+    e = (struct extent*)bp->data;
+    for(i = 0; i < NXEXTENT; i++)
+      n += e[i].len;
+    brelse(bp);
+  }
+  return n;
+}
 
-// bn相当于第n个block
+// Append up to n zeroed blocks to the end of ip, allocating
+// them right after its last block where possible so that the
+// file stays in few, long extents.
+// Returns the number of blocks appended, which is less than n
+// if the disk or ip's extent list is full.
+// Caller must hold ip->lock and be in a transaction.
 static uint
-bmap(struct inode *ip, uint bn)
+iextend(struct inode *ip, uint n)
 {
-  uint addr, *a;
   struct buf *bp;
+  struct extent *e, *last, *next;
+  uint start, got, goal, done;
+  int i;
 
-  // 当块号小于直接块的时候
-  if(bn < NDIRECT){
-    if((addr = ip->addrs[bn]) == 0){
-      addr = balloc(ip->dev); // 相当于没有就就进行分配块
-      if(addr == 0)
-        return 0;
-      ip->addrs[bn] = addr;
-    }
-    return addr;
+  bp = 0;
+  e = 0;
+  if(ip->xblock){
+    bp = bread(ip->dev, ip->xblock);
+    e = (struct extent*)bp->data;
   }
-  // 当磁盘块号>直接块数
-  bn -= NDIRECT;
 
-  if(bn < NINDIRECT){
-    // Load indirect block, allocating if necessary.
-    if((addr = ip->addrs[NDIRECT]) == 0){
-      addr = balloc(ip->dev); // 首先分配一级间接块
-      if(addr == 0)
-        return 0;
-      ip->addrs[NDIRECT] = addr;
+  for(done = 0; done < n; done += got){
+    // find the last extent, and the free slot after it.
+    last = next = 0;
+    for(i = 0; i < NEXTENT && ip->ext[i].len; i++)
+      last = &ip->ext[i];
+    if(i < NEXTENT)
+      next = &ip->ext[i];
+    else if(e){
+      for(i = 0; i < NXEXTENT && e[i].len; i++)
+        last = &e[i];
+      if(i < NXEXTENT)
+        next = &e[i];
     }
-    // 分配二级磁盘块
-    bp = bread(ip->dev, addr);
-    a = (uint*)bp->data;
-    if((addr = a[bn]) == 0){
-      addr = balloc(ip->dev);
-      if(addr){
-        a[bn] = addr;
-        log_write(bp);
+
+    // an empty file starts at a spot picked by its inode number,
+    // so that files written at the same time don't interleave.
+    if(last)
+      goal = last->start + last->len;
+    else
+      goal = sb.bmapstart + ip->inum * ((sb.size - sb.bmapstart) / sb.ninodes);
+    if((start = ballocn(ip->dev, goal, n - done, &got)) == 0)
+      break;
+    if(last && start == goal){
+      last->len += got;
+    } else {
+      if(next == 0 && e == 0){
+        // the inode's extents are full; start the extent block.
+        if((ip->xblock = balloc(ip->dev, start)) == 0){
+          bfreen(ip->dev, start, got);
+          break;
+        }
+        bp = bread(ip->dev, ip->xblock);
+        e = (struct extent*)bp->data;
+        next = &e[0];
+      }
+      if(next == 0){
+        bfreen(ip->dev, start, got);
+        break;
       }
+      next->start = start;
+      next->len = got;
     }
+    if(bp)
+      log_write(bp);
+  }
+
+  if(bp)
     brelse(bp);
-    // 返回对应的磁盘块的地址
+  return done;
+}
+
+// Return the disk block address of the nth block in inode ip.
+// If there is no such block, bmap allocates blocks up to
+// and including it.
+// returns 0 if out of disk space.
+uint
+bmap(struct inode *ip, uint bn)
+{
+  uint addr, have;
+
+  if(bn >= MAXFILE)
+    panic("bmap: out of range");
+  if((addr = emap(ip, bn)) != 0)
     return addr;
-  }
 
-  panic("bmap: out of range");
+  have = iblocks(ip);
+  if(iextend(ip, bn + 1 - have) != bn + 1 - have)
+    return 0;
+  return emap(ip, bn);
 }
 
 // Truncate inode (discard contents).
 // Caller must hold ip->lock.
-void
+// Returns 0, or -1 if a process is running the file as a
+// program, whose text vmaload() may still read.
+int
 itrunc(struct inode *ip)
 {
-  int i, j;
+  int i;
   struct buf *bp;
-  uint *a;
+  struct extent *e;
 
-  for(i = 0; i < NDIRECT; i++){
-    if(ip->addrs[i]){
-      bfree(ip->dev, ip->addrs[i]);
-      ip->addrs[i] = 0;
-    }
+  if(ip->nexec > 0)
+    return -1;
+  textinval(ip);
+  pcacheinval(ip);
+  for(i = 0; i < NEXTENT; i++){
+    if(ip->ext[i].len)
+      bfreen(ip->dev, ip->ext[i].start, ip->ext[i].len);
+    ip->ext[i].start = 0;
+    ip->ext[i].len = 0;
   }
 
-  if(ip->addrs[NDIRECT]){
-    bp = bread(ip->dev, ip->addrs[NDIRECT]);
-    a = (uint*)bp->data;
-    for(j = 0; j < NINDIRECT; j++){
-      if(a[j])
-        bfree(ip->dev, a[j]);
+  if(ip->xblock){
+    bp = bread(ip->dev, ip->xblock);
+    e = (struct extent*)bp->data;
+    for(i = 0; i < NXEXTENT; i++){
+      if(e[i].len)
+        bfreen(ip->dev, e[i].start, e[i].len);
     }
     brelse(bp);
-    bfree(ip->dev, ip->addrs[NDIRECT]);
-    ip->addrs[NDIRECT] = 0;
+    bfreen(ip->dev, ip->xblock, 1);
+    ip->xblock = 0;
   }
 
   ip->size = 0;
   iupdate(ip);
+  return 0;
 }
 
 // Copy stat information from inode.
@@ -484,11 +888,25 @@ itrunc(struct inode *ip)
 void
 stati(struct inode *ip, struct stat *st)
 {
+  struct buf *bp;
+  struct extent *e;
+  int i;
+
   st->dev = ip->dev;
   st->ino = ip->inum;
   st->type = ip->type;
   st->nlink = ip->nlink;
   st->size = ip->size;
+  st->nextent = 0;
+  for(i = 0; i < NEXTENT && ip->ext[i].len; i++)
+    st->nextent++;
+  if(ip->xblock){
+    bp = bread(ip->dev, ip->xblock);
+    e = (struct extent*)bp->data;
+    for(i = 0; i < NXEXTENT && e[i].len; i++)
+      st->nextent++;
+    brelse(bp);
+  }
 }
 
 // Read data from inode.
@@ -503,6 +921,7 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 {
   uint tot, m;
   struct buf *bp;
+  struct pcpage *pg;
   
   if(off > ip->size || off + n < off)
     return 0;
@@ -510,6 +929,18 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
     n = ip->size - off;
 
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
+    // Copy out of the page cache if there is memory for it,
+    // otherwise straight from the buffer cache.
+    if((pg = pcacheget(ip, off/PGSIZE)) != 0){
+      m = min(n - tot, PGSIZE - off%PGSIZE);
+      if(either_copyout(user_dst, dst, pg->data + (off % PGSIZE), m) == -1) {
+        pcacheput(pg);
+        tot = -1;
+        break;
+      }
+      pcacheput(pg);
+      continue;
+    }
     // 获取指定块的地址(磁盘块号)
     uint addr = bmap(ip, off/BSIZE);
     if(addr == 0)
@@ -528,23 +959,46 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
   return tot;
 }
 
+// Start reading the pages of ip that hold [off, off+n) into
+// the page cache, without waiting for them, so that a later
+// readi() finds them there. Caller must hold ip->lock.
+void
+readahead(struct inode *ip, uint off, uint n)
+{
+  if(ip->type != T_FILE || off >= ip->size || n == 0)
+    return;
+  if(n > ip->size - off)
+    n = ip->size - off;
+  pcacheahead(ip, off/PGSIZE, (off + n - 1)/PGSIZE - off/PGSIZE + 1);
+}
+
 // Write data to inode.
 // Caller must hold ip->lock.
 // If user_src==1, then src is a user virtual address;
 // otherwise, src is a kernel address.
 // Returns the number of bytes successfully written.
 // If the return value is less than the requested n,
-// there was an error of some kind.
+// there was an error of some kind, such as the file being
+// a running program.
 int
 writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
 {
-  uint tot, m;
+  uint tot, m, have, need;
   struct buf *bp;
 
+  if(ip->nexec > 0)
+    return -1;
   if(off > ip->size || off + n < off)
     return -1;
   if(off + n > MAXFILE*BSIZE)
     return -1;
+  textinval(ip);
+
+  // allocate the blocks this write adds all at once, so
+  // they can come from one run of free blocks.
+  need = (off + n + BSIZE - 1) / BSIZE;
+  if((have = iblocks(ip)) < need)
+    iextend(ip, need - have);
 
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
     uint addr = bmap(ip, off/BSIZE);
@@ -557,6 +1011,7 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
       break;
     }
     log_write(bp);
+    pcachewrite(ip, off, (char*)bp->data + (off % BSIZE), m);
     brelse(bp);
   }
 
@@ -565,7 +1020,7 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
 
   // write the i-node back to disk even if the size didn't change
   // because the loop above might have called bmap() and added a new
-  // block to ip->addrs[].
+  // block to ip->ext[].
   iupdate(ip);
 
   return tot;
@@ -579,6 +1034,268 @@ namecmp(const char *s, const char *t)
   return strncmp(s, t, DIRSIZ);
 }
 
+// Hashed directories.
+//
+// A directory that fills its first block is converted to a
+// hashed directory (see struct dirhead in fs.h), so that a lookup
+// or insert reads one leaf instead of every entry. When a name
+// doesn't fit in its leaf, the leaf splits in two on the next bit
+// of the hash, doubling the index first if every slot is in use;
+// a leaf at DIRDEPTH grows a chain of further leaves instead.
+// Leaves never merge, and unlink just clears the entry. Older
+// plain directories bigger than one block stay plain.
+
+static char dirzero[BSIZE];
+
+// FNV-1a hash of a directory entry name.
+static uint
+dirhash(char *name)
+{
+  uint h;
+  int i;
+
+  h = 2166136261;
+  for(i = 0; i < DIRSIZ && name[i]; i++){
+    h ^= (uchar)name[i];
+    h *= 16777619;
+  }
+  return h;
+}
+
+// Read the dirent-sized record at off in directory dp.
+static void
+dirread(struct inode *dp, uint off, void *p)
+{
+  if(readi(dp, 0, (uint64)p, off, sizeof(struct dirent)) != sizeof(struct dirent))
+    panic("dirread");
+}
+
+// Write the dirent-sized record at off in directory dp.
+static int
+dirwrite(struct inode *dp, uint off, void *p)
+{
+  if(writei(dp, 0, (uint64)p, off, sizeof(struct dirent)) != sizeof(struct dirent))
+    return -1;
+  return 0;
+}
+
+// Return the depth of hashed directory dp's index,
+// or -1 if dp is a plain array of dirents.
+static int
+dirdepth(struct inode *dp)
+{
+  struct dirhead h;
+
+  if(dp->size < BSIZE)
+    return -1;
+  dirread(dp, 2*sizeof(struct dirent), &h);
+  if(h.inum != 0 || h.magic != DIRHASH)
+    return -1;
+  return h.depth;
+}
+
+// Offset of the index record holding slot i.
+#define DIRSLOTOFF(i) ((3 + (i) / DIRNIDX) * sizeof(struct dirent))
+
+static uint
+dirslot(struct inode *dp, uint i)
+{
+  struct diridx x;
+
+  dirread(dp, DIRSLOTOFF(i), &x);
+  return x.leaf[i % DIRNIDX];
+}
+
+static void
+dirsetslot(struct inode *dp, uint i, uint leaf)
+{
+  struct diridx x;
+
+  dirread(dp, DIRSLOTOFF(i), &x);
+  x.leaf[i % DIRNIDX] = leaf;
+  dirwrite(dp, DIRSLOTOFF(i), &x);
+}
+
+// Append an empty leaf with the given depth to directory dp.
+// Returns its block number within dp, or 0 if out of disk space.
+static uint
+dirnewleaf(struct inode *dp, int depth)
+{
+  struct dirhead h;
+  uint leaf;
+
+  leaf = dp->size / BSIZE;
+  if(writei(dp, 0, (uint64)dirzero, leaf*BSIZE, BSIZE) != BSIZE)
+    return 0;
+  memset(&h, 0, sizeof(h));
+  h.magic = DIRLEAF;
+  h.depth = depth;
+  dirwrite(dp, leaf*BSIZE, &h);
+  return leaf;
+}
+
+// Convert dp, a plain directory whose one block is full, into a
+// hashed directory with two leaves.
+static int
+dirconvert(struct inode *dp)
+{
+  struct dirent de;
+  struct dirhead h;
+  struct diridx x;
+  uint leaf[2], n[2], off, i;
+
+  if((leaf[0] = dirnewleaf(dp, 1)) == 0 || (leaf[1] = dirnewleaf(dp, 1)) == 0)
+    return -1;
+  n[0] = n[1] = 1;
+  for(off = 2*sizeof(de); off < BSIZE; off += sizeof(de)){
+    dirread(dp, off, &de);
+    if(de.inum == 0)
+      continue;
+    i = dirhash(de.name) & 1;
+    dirwrite(dp, leaf[i]*BSIZE + n[i]++*sizeof(de), &de);
+  }
+
+  memset(&de, 0, sizeof(de));
+  for(off = 2*sizeof(de); off < BSIZE; off += sizeof(de))
+    dirwrite(dp, off, &de);
+  memset(&x, 0, sizeof(x));
+  x.leaf[0] = leaf[0];
+  x.leaf[1] = leaf[1];
+  dirwrite(dp, DIRSLOTOFF(0), &x);
+  memset(&h, 0, sizeof(h));
+  h.magic = DIRHASH;
+  h.depth = 1;
+  dirwrite(dp, 2*sizeof(de), &h);
+  return 0;
+}
+
+// Split leaf, which uses the low ld bits of the hash, in two:
+// entries with bit ld set move to a new leaf. gd is the depth of
+// the index, which doubles first if ld == gd.
+static int
+dirsplit(struct inode *dp, uint leaf, int ld, int gd)
+{
+  struct dirent de;
+  struct dirhead h;
+  uint new, i, j;
+
+  if((new = dirnewleaf(dp, ld + 1)) == 0)
+    return -1;
+
+  if(ld == gd){
+    for(i = 0; i < (1 << gd); i++)
+      dirsetslot(dp, i + (1 << gd), dirslot(dp, i));
+    dirread(dp, 2*sizeof(de), &h);
+    h.depth = ++gd;
+    dirwrite(dp, 2*sizeof(de), &h);
+  }
+  for(i = 0; i < (1 << gd); i++){
+    if((i & (1 << ld)) && dirslot(dp, i) == leaf)
+      dirsetslot(dp, i, new);
+  }
+
+  j = 1;
+  for(i = 1; i < DPB; i++){
+    dirread(dp, leaf*BSIZE + i*sizeof(de), &de);
+    if(de.inum == 0 || (dirhash(de.name) & (1 << ld)) == 0)
+      continue;
+    dirwrite(dp, new*BSIZE + j++*sizeof(de), &de);
+    memset(&de, 0, sizeof(de));
+    dirwrite(dp, leaf*BSIZE + i*sizeof(de), &de);
+  }
+  dirread(dp, leaf*BSIZE, &h);
+  h.depth = ld + 1;
+  dirwrite(dp, leaf*BSIZE, &h);
+  return 0;
+}
+
+// Look for name in hashed directory dp, whose index has the
+// given depth.
+static struct inode*
+dirhlookup(struct inode *dp, int depth, char *name, uint *poff)
+{
+  struct dirent de;
+  struct dirhead h;
+  uint leaf, off;
+  int i;
+
+  // "." and ".." stay at the start of block 0.
+  if(name[0] == '.'){
+    for(off = 0; off < 2*sizeof(de); off += sizeof(de)){
+      dirread(dp, off, &de);
+      if(de.inum && namecmp(name, de.name) == 0){
+        if(poff)
+          *poff = off;
+        return iget(dp->dev, de.inum);
+      }
+    }
+  }
+
+  leaf = dirslot(dp, dirhash(name) & ((1 << depth) - 1));
+  while(leaf){
+    for(i = 1; i < DPB; i++){
+      off = leaf*BSIZE + i*sizeof(de);
+      dirread(dp, off, &de);
+      if(de.inum && namecmp(name, de.name) == 0){
+        if(poff)
+          *poff = off;
+        return iget(dp->dev, de.inum);
+      }
+    }
+    dirread(dp, leaf*BSIZE, &h);
+    leaf = h.next;
+  }
+  return 0;
+}
+
+// Add (name, inum) to hashed directory dp.
+// The caller's transaction must have room for DIROPBLOCKS.
+static int
+dirhlink(struct inode *dp, int depth, char *name, uint inum)
+{
+  struct dirent de;
+  struct dirhead h;
+  uint hash, first, leaf, next, off;
+  int i;
+
+  hash = dirhash(name);
+  for(;;){
+    // look for a free dirent in the name's leaf and its chain.
+    first = leaf = dirslot(dp, hash & ((1 << depth) - 1));
+    for(;;){
+      for(i = 1; i < DPB; i++){
+        off = leaf*BSIZE + i*sizeof(de);
+        dirread(dp, off, &de);
+        if(de.inum == 0)
+          goto found;
+      }
+      dirread(dp, leaf*BSIZE, &h);
+      if(h.next == 0)
+        break;
+      leaf = h.next;
+    }
+
+    // full: split the leaf and try again, or chain another.
+    if(h.depth < DIRDEPTH){
+      if(dirsplit(dp, first, h.depth, depth) < 0)
+        return -1;
+      depth = dirdepth(dp);
+      continue;
+    }
+    if((next = dirnewleaf(dp, h.depth)) == 0)
+      return -1;
+    h.next = next;
+    dirwrite(dp, leaf*BSIZE, &h);
+    off = next*BSIZE + sizeof(de);
+    break;
+  }
+
+found:
+  strncpy(de.name, name, DIRSIZ);
+  de.inum = inum;
+  return dirwrite(dp, off, &de);
+}
+
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
 // 查找dp对应目录中名称为name的子目录对应的inode
@@ -586,11 +1303,15 @@ struct inode*
 dirlookup(struct inode *dp, char *name, uint *poff)
 {
   uint off, inum;
+  int depth;
   struct dirent de;
 
   if(dp->type != T_DIR)
     panic("dirlookup not DIR");
 
+  if((depth = dirdepth(dp)) >= 0)
+    return dirhlookup(dp, depth, name, poff);
+
   // 相当于在每一个inode查找对应name
   for(off = 0; off < dp->size; off += sizeof(de)){
     // 将磁盘块dp的内容读入到de中
@@ -614,10 +1335,12 @@ dirlookup(struct inode *dp, char *name, uint *poff)
 
 // Write a new directory entry (name, inum) into the directory dp.
 // Returns 0 on success, -1 on failure (e.g. out of disk blocks).
+// Must be called inside a transaction begun with
+// begin_opn(DIROPBLOCKS).
 int
 dirlink(struct inode *dp, char *name, uint inum)
 {
-  int off;
+  int off, depth;
   struct dirent de;
   struct inode *ip;
 
@@ -627,6 +1350,13 @@ dirlink(struct inode *dp, char *name, uint inum)
     return -1;
   }
 
+  if((depth = dirdepth(dp)) >= 0){
+    if(dirhlink(dp, depth, name, inum) < 0)
+      return -1;
+    dcacheput(dp, name, inum);
+    return 0;
+  }
+
   // Look for an empty dirent.
   for(off = 0; off < dp->size; off += sizeof(de)){
     if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
@@ -635,10 +1365,19 @@ dirlink(struct inode *dp, char *name, uint inum)
       break;
   }
 
+  // Hash the directory rather than give it a second block.
+  if(off == BSIZE && dp->size == BSIZE && dirconvert(dp) == 0){
+    if(dirhlink(dp, 1, name, inum) < 0)
+      return -1;
+    dcacheput(dp, name, inum);
+    return 0;
+  }
+
   strncpy(de.name, name, DIRSIZ);
   de.inum = inum;
   if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
     return -1;
+  dcacheput(dp, name, inum);
 
   return 0;
 }
@@ -705,6 +1444,15 @@ namex(char *path, int nameiparent, char *name)
   // example: /ab/ac/ad
   // skipelem在path为""时的返回值才为0
   while((path = skipelem(path, name)) != 0){
+    // A cached component needs no lock on the directory. Only
+    // directories have entries, so ip must be one.
+    if(!(nameiparent && *path == '\0') && dcachelookup(ip, name, &next)){
+      iput(ip);
+      if(next == 0)
+        return 0;
+      ip = next;
+      continue;
+    }
     ilock(ip);
     // 在遍历完成之前可以保证它们都是目录
     if(ip->type != T_DIR){
@@ -718,7 +1466,9 @@ namex(char *path, int nameiparent, char *name)
       return ip;
     }
     // 查找当前目录名称为name的子目录, 其中ip为当前的目录
-    if((next = dirlookup(ip, name, 0)) == 0){
+    next = dirlookup(ip, name, 0);
+    dcacheput(ip, name, next ? next->inum : 0);
+    if(next == 0){
       iunlockput(ip);
       return 0;
     }
@@ -25,10 +25,18 @@ struct superblock {
 
 #define FSMAGIC 0x10203040
 
-// 11(存储对应的data block块号) + 1(二级间接data block块号)
-#define NDIRECT 12
-#define NINDIRECT (BSIZE / sizeof(uint))
-#define MAXFILE (NDIRECT + NINDIRECT)
+// A file's data lives in extents: runs of len consecutive disk
+// blocks starting at start, in file order. The first NEXTENT are
+// in the inode; if a file needs more, the rest are in a single
+// extent block, xblock. A file has no holes.
+struct extent {
+  uint start;           // First disk block of the run
+  uint len;             // Number of blocks in the run
+};
+
+#define NEXTENT 6
+#define NXEXTENT (BSIZE / sizeof(struct extent))
+#define MAXFILE 8192    // max file size, in blocks
 
 // On-disk inode structure
 // 磁盘中inode结构
@@ -38,7 +46,8 @@ struct dinode {
   short minor;          // Minor device number (T_DEVICE only)
   short nlink;          // Number of links to inode in file system
   uint size;            // Size of file (bytes)
-  uint addrs[NDIRECT+1];   // Data block addresses
+  struct extent ext[NEXTENT];   // Data block runs
+  uint xblock;          // Block of further extents, or 0
 };
 
 // Inodes per block.
@@ -64,3 +73,36 @@ struct dirent {
   char name[DIRSIZ];
 };
 
+
+// Dirents per block.
+#define DPB           (BSIZE / sizeof(struct dirent))
+
+// A hashed directory keeps "." and ".." in the first two dirents
+// of block 0. The third is a dirhead, and the ones after it are
+// an index of 1<<depth slots, DIRNIDX per diridx. Slot i names the
+// leaf block holding the entries whose name hash ends in i. Each
+// leaf starts with a dirhead of its own. The headers and index
+// have inum 0 so that readers of the raw dirents skip them.
+struct dirhead {
+  ushort inum;          // Always 0
+  ushort magic;         // DIRHASH in block 0, DIRLEAF in a leaf
+  ushort depth;         // Bits of the hash used by the index or leaf
+  ushort next;          // Leaf: block of next leaf in chain, or 0
+  char pad[8];
+};
+
+#define DIRNIDX 7
+struct diridx {
+  ushort inum;          // Always 0
+  ushort leaf[DIRNIDX]; // Leaf blocks of 7 consecutive slots
+};
+
+#define DIRHASH  0x4844   // "DH"
+#define DIRLEAF  0x4c44   // "DL"
+#define DIRDEPTH 8        // Max depth; deeper leaves are chained
+
+// Blocks to reserve with begin_opn() for a system call that adds
+// a directory entry: one insert may split a leaf at each depth
+// down to DIRDEPTH and then chain another, writing a leaf block
+// for each on top of what any other FS call writes.
+#define DIROPBLOCKS (MAXOPBLOCKS + DIRDEPTH + 2)
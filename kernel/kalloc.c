@@ -19,17 +19,43 @@ struct run {
   struct run *next;
 };
 
-struct {
+// Each CPU allocates from and frees to its own list, so the
+// common case touches only a lock that no other hart wants.
+// A CPU whose list runs dry refills KBATCH pages from the
+// shared pool, or steals half of a sibling's list if the pool
+// is empty too. A CPU whose list grows past 2*KBATCH gives
+// KBATCH pages back to the pool.
+#define KBATCH 32
+
+struct kcpu {
   struct spinlock lock;
   struct run *freelist;
+  int nfree;
+};
+
+struct {
+  struct spinlock lock;   // protects the shared pool
+  struct run *freelist;
+  int nfree;
+  struct kcpu cpu[NCPU];
 } kmem;
 
+// Reference counts for physical pages, indexed by page number
+// above KERNBASE. kalloc() hands out a page with one reference;
+// copy-on-write fork adds one for every page table that shares
+// the page, and kfree() only frees it when the last one is gone.
+// Updated with atomic instructions so that no lock is needed.
+#define PA2REF(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+static int kref[(PHYSTOP - KERNBASE) / PGSIZE];
+
 // 初始化内存
 void
 kinit()
 {
   // 初始化memory lock
-  initlock(&kmem.lock, "kmem"); 
+  initlock(&kmem.lock, "kmem");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&kmem.cpu[i].lock, "kmem_cpu");
   // 初始化所有从end -> PHYSTOP的页
   // 这些都是实际的物理内存
   freerange(end, (void*)PHYSTOP);
@@ -44,8 +70,84 @@ freerange(void *pa_start, void *pa_end)
   char *p;
   // 因为一个页的大小是4096, 这里首先向上对齐
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
+    kref[PA2REF(p)] = 1;
     kfree(p);
+  }
+}
+
+// Detach up to n pages from the front of *list.
+// Returns the detached chain and stores its length in *got.
+static struct run*
+kdetach(struct run **list, int n, int *got)
+{
+  struct run *head, *tail;
+  int i;
+
+  head = *list;
+  if(head == 0){
+    *got = 0;
+    return 0;
+  }
+  tail = head;
+  for(i = 1; i < n && tail->next; i++)
+    tail = tail->next;
+  *list = tail->next;
+  tail->next = 0;
+  *got = i;
+  return head;
+}
+
+// Find pages for CPU id, whose own list was empty: first a batch
+// from the shared pool, then half of the fullest sibling's list.
+// Hands one page back to the caller and puts the rest on the
+// CPU's list. Must be called with interrupts off and without
+// holding any kmem lock, so that two harts stealing from each
+// other cannot deadlock.
+static struct run*
+krefill(int id)
+{
+  struct run *r;
+  struct kcpu *kc, *victim;
+  int i, n;
+
+  acquire(&kmem.lock);
+  r = kdetach(&kmem.freelist, KBATCH, &n);
+  kmem.nfree -= n;
+  release(&kmem.lock);
+
+  if(r == 0){
+    // pool is empty; steal from the sibling with the most pages.
+    // nfree is read without the lock, it is only a hint.
+    victim = 0;
+    for(i = 0; i < NCPU; i++){
+      kc = &kmem.cpu[i];
+      if(i != id && kc->nfree > 0 && (victim == 0 || kc->nfree > victim->nfree))
+        victim = kc;
+    }
+    if(victim == 0)
+      return 0;
+    acquire(&victim->lock);
+    r = kdetach(&victim->freelist, (victim->nfree + 1) / 2, &n);
+    victim->nfree -= n;
+    release(&victim->lock);
+    if(r == 0)
+      return 0;
+  }
+
+  if(r->next){
+    kc = &kmem.cpu[id];
+    acquire(&kc->lock);
+    for(i = 0; r->next; i++){
+      struct run *x = r->next;
+      r->next = x->next;
+      x->next = kc->freelist;
+      kc->freelist = x;
+    }
+    kc->nfree += i;
+    release(&kc->lock);
+  }
+  return r;
 }
 
 // Free the page of physical memory pointed at by pa,
@@ -54,14 +156,34 @@ freerange(void *pa_start, void *pa_end)
 // initializing the allocator; see kinit above.)
 // 释放内存页, 本质上就是将这个页放在
 // 链表中
+// If the page is shared, this only drops one reference.
 void
 kfree(void *pa)
 {
-  struct run *r;
+  kput(pa);
+}
+
+// Drop one reference to the page at pa, freeing the page if it
+// was the last. Returns the number of references left, so that
+// a caller that keeps its own index of pages can update it under
+// the same lock as the decision.
+int
+kput(void *pa)
+{
+  struct run *r, *batch;
+  struct kcpu *kc;
+  int n;
+
   // 首先检查是否对齐和地址范围
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
+  n = __sync_sub_and_fetch(&kref[PA2REF(pa)], 1);
+  if(n > 0)
+    return n;
+  if(n < 0)
+    panic("kfree: ref");
+
   // Fill with junk to catch dangling refs.
   // 初始化是为了快速捕捉dangling 引用问题
   memset(pa, 1, PGSIZE);
@@ -69,12 +191,33 @@ kfree(void *pa)
   // 转换为run结构体致函
   r = (struct run*)pa;
 
-  acquire(&kmem.lock);
-  // 链表进行连接, 这里首先需要获得锁, 因为
-  // 可能多个CPU同时free
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  release(&kmem.lock);
+  // push_off() keeps us on this CPU until the page is on its list.
+  push_off();
+  kc = &kmem.cpu[cpuid()];
+  acquire(&kc->lock);
+  r->next = kc->freelist;
+  kc->freelist = r;
+  kc->nfree++;
+  batch = 0;
+  n = 0;
+  if(kc->nfree > 2*KBATCH){
+    batch = kdetach(&kc->freelist, KBATCH, &n);
+    kc->nfree -= n;
+  }
+  release(&kc->lock);
+
+  if(batch){
+    // give a batch back to the pool for other CPUs.
+    for(r = batch; r->next; r = r->next)
+      ;
+    acquire(&kmem.lock);
+    r->next = kmem.freelist;
+    kmem.freelist = batch;
+    kmem.nfree += n;
+    release(&kmem.lock);
+  }
+  pop_off();
+  return 0;
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -84,14 +227,60 @@ void *
 kalloc(void)
 {
   struct run *r;
+  struct kcpu *kc;
+  int id;
 
-  acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
-  release(&kmem.lock);
+  push_off();
+  id = cpuid();
+  kc = &kmem.cpu[id];
+  acquire(&kc->lock);
+  r = kc->freelist;
+  if(r){
+    kc->freelist = r->next;
+    kc->nfree--;
+  }
+  release(&kc->lock);
+  if(r == 0)
+    r = krefill(id);
+  pop_off();
 
-  if(r)
+  // Out of memory: give back some clean file pages and retry.
+  if(r == 0 && pcachereclaim(KBATCH) > 0)
+    return kalloc();
+
+  if(r){
+    kref[PA2REF(r)] = 1;
     memset((char*)r, 5, PGSIZE); // fill with junk
+  }
   return (void*)r;
 }
+
+// Return the number of free pages.
+int
+kfreepages(void)
+{
+  int i, n;
+
+  n = kmem.nfree;
+  for(i = 0; i < NCPU; i++)
+    n += kmem.cpu[i].nfree;
+  return n;
+}
+
+// Add a reference to the page at pa, which must already
+// have been allocated by kalloc().
+void
+krefinc(void *pa)
+{
+  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+    panic("krefinc");
+  if(__sync_fetch_and_add(&kref[PA2REF(pa)], 1) < 1)
+    panic("krefinc: free page");
+}
+
+// Return the number of references to the page at pa.
+int
+krefcnt(void *pa)
+{
+  return __atomic_load_n(&kref[PA2REF(pa)], __ATOMIC_SEQ_CST);
+}
@@ -6,6 +6,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "proc.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
@@ -29,6 +30,25 @@
 //   block C
 //   ...
 // Log appends are synchronous.
+//
+// Commits are done by the commit thread, in groups. It closes
+// the running transaction when no FS system call is active in it,
+// or when it has grown large enough that new calls should wait for
+// the running ones to finish. Closing copies the transaction's
+// blocks into the log's buffers, so FS system calls can go on
+// changing the cached blocks, in a new transaction, while the
+// closed one is written to the log. end_op() waits for the
+// transaction its call was part of to commit, if the call logged
+// any blocks; a call that only read has nothing to wait for.
+//
+// Installing committed blocks at their home locations is not
+// synchronous either.
+// A commit only writes the log and the header; the blocks stay
+// pinned in the buffer cache, and later transactions append to
+// the log after them. The flusher thread checkpoints the log when
+// it is half full, or when begin_op() runs out of room: it waits
+// for FS system calls to drain, writes the cached blocks home in
+// block order, and then empties the log.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
@@ -42,16 +62,29 @@ struct logheader {
 struct log {
   struct spinlock lock;
   int start;
-  int size;
+  int size;        // data blocks the log holds, at most LOGSIZE
   int outstanding; // how many FS sys calls are executing.
-  int committing;  // in commit(), please wait.
+  int reserved;    // blocks they may still log, together.
+  int closing;     // commit thread is closing the transaction, please wait.
+  int checkpointing; // flusher is installing the log, please wait.
+  int full;        // begin_op() is waiting for log space.
+  int ncommit;     // lh.block[0..ncommit) are committed,
+  int nclosed;     // [ncommit..nclosed) are being committed,
+                   // [nclosed..n) are the running transaction.
+  int seq;         // number of the running transaction, from 1.
+  int done;        // number of the last committed transaction, 0 if none.
   int dev;
   struct logheader lh;
 };
 struct log log;
 
+// Home-location writes kept in flight at once. Each holds a
+// buffer, which during recovery is not already pinned in the cache.
+#define INSTALLBATCH 8
+
 static void recover_from_log(void);
-static void commit();
+static void committer(void);
+static void flusher(void);
 
 void
 initlog(int dev, struct superblock *sb)
@@ -61,30 +94,61 @@ initlog(int dev, struct superblock *sb)
 
   initlock(&log.lock, "log");
   log.start = sb->logstart;
-  log.size = sb->nlog;
+  log.size = sb->nlog - 1;  // less the header block
+  if (log.size > LOGSIZE)
+    log.size = LOGSIZE;
   log.dev = dev;
+  // transactions are numbered from 1, so that end_opn() in the
+  // first one waits for done to reach it.
+  log.seq = 1;
+  log.done = 0;
   recover_from_log();
+  kthread("logcommit", committer);
+  kthread("flusher", flusher);
 }
 
-// Copy committed blocks from log to their home location
+// The largest number of blocks one FS system call may log with
+// begin_opn(): a quarter of the log, so that a few can run at once.
+int
+log_opmax(void)
+{
+  if (log.size / 4 < MAXOPBLOCKS)
+    return MAXOPBLOCKS;
+  return log.size / 4;
+}
+
+// Copy committed blocks from the log to their home locations,
+// after a crash. A block may be in the log more than once; only
+// its last copy is installed. The writes are started a batch at
+// a time and then waited for together, so the disk has many of
+// them in flight at once.
 static void
-install_trans(int recovering)
+install_trans(void)
 {
-  int tail;
+  struct buf *dbuf[INSTALLBATCH];
+  int tail, i, j, n;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    if(recovering == 0)
-      bunpin(dbuf);
-    brelse(lbuf);
-    brelse(dbuf);
+  for (tail = 0; tail < log.lh.n; ) {
+    for (n = 0; tail < log.lh.n && n < INSTALLBATCH; tail++) {
+      for (j = tail+1; j < log.lh.n; j++)
+        if (log.lh.block[j] == log.lh.block[tail])
+          break;
+      if (j < log.lh.n)
+        continue;  // logged again later
+      struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
+      dbuf[n] = bread(log.dev, log.lh.block[tail]); // read dst
+      memmove(dbuf[n]->data, lbuf->data, BSIZE);  // copy block to dst
+      bstartwrite(dbuf[n]);  // write dst to disk
+      brelse(lbuf);
+      n++;
+    }
+    for (i = 0; i < n; i++) {
+      bwait(dbuf[i]);
+      brelse(dbuf[i]);
+    }
   }
 }
 
-// Read the log header from disk into the in-memory log header
 static void
 read_head(void)
 {
@@ -92,23 +156,25 @@ read_head(void)
   struct logheader *lh = (struct logheader *) (buf->data);
   int i;
   log.lh.n = lh->n;
+  if (log.lh.n < 0 || log.lh.n > log.size)
+    panic("read_head");
   for (i = 0; i < log.lh.n; i++) {
     log.lh.block[i] = lh->block[i];
   }
   brelse(buf);
 }
 
-// Write in-memory log header to disk.
+// Write the first n entries of the in-memory log header to disk.
 // This is the true point at which the
-// current transaction commits.
+// transactions they belong to commit.
 static void
-write_head(void)
+write_head(int n)
 {
   struct buf *buf = bread(log.dev, log.start);
   struct logheader *hb = (struct logheader *) (buf->data);
   int i;
-  hb->n = log.lh.n;
-  for (i = 0; i < log.lh.n; i++) {
+  hb->n = n;
+  for (i = 0; i < n; i++) {
     hb->block[i] = log.lh.block[i];
   }
   bwrite(buf);
@@ -119,28 +185,39 @@ static void
 recover_from_log(void)
 {
   read_head();
-  install_trans(1); // if committed, copy from log to disk
+  install_trans(); // if committed, copy from log to disk
   log.lh.n = 0;
-  write_head(); // clear the log
+  write_head(0); // clear the log
 }
 
 // called at the start of each FS system call.
-// 在开始进行文件系统调用之前的操作
 void
 begin_op(void)
+{
+  begin_opn(MAXOPBLOCKS);
+}
+
+// start an FS system call that may log up to n blocks.
+// 在开始进行文件系统调用之前的操作
+void
+begin_opn(int n)
 {
   // 在文件系统操作之前, 需要满足所有的日志已经提交
   acquire(&log.lock);
   while(1){
     // 如果正在提交, 则休眠
-    if(log.committing){
+    if(log.closing || log.checkpointing){
       sleep(&log, &log.lock);
-    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){ // 日志空间已经满了
-      // this op might exhaust log space; wait for commit.
+    } else if(log.lh.n + log.reserved + n > log.size){ // 日志空间已经满了
+      // this op might exhaust log space; wait for commit
+      // and checkpoint.
+      log.full = 1;
+      wakeup(&log.checkpointing);
       sleep(&log, &log.lock);
     } else {
       // 可以执行fs调用
       log.outstanding += 1;
+      log.reserved += n;
       release(&log.lock);
       break;
     }
@@ -148,69 +225,192 @@ begin_op(void)
 }
 
 // called at the end of each FS system call.
-// commits if this was the last outstanding operation.
 void
 end_op(void)
 {
-  int do_commit = 0;
+  end_opn(MAXOPBLOCKS);
+}
+
+// called at the end of an FS system call started by begin_opn(n).
+// waits for the transaction to commit, if this call logged
+// any blocks.
+void
+end_opn(int n)
+{
+  struct proc *p = myproc();
 
   acquire(&log.lock);
   log.outstanding -= 1;
-  if(log.committing)
-    panic("log.committing");
-  if(log.outstanding == 0){
-    do_commit = 1;
-    log.committing = 1;
-  } else {
-    // begin_op() may be waiting for log space,
-    // and decrementing log.outstanding has decreased
-    // the amount of reserved space.
-    wakeup(&log);
-  }
+  log.reserved -= n;
+  if(log.outstanding < 0 || log.reserved < 0)
+    panic("end_op");
+  // the commit thread may be waiting for the transaction to
+  // drain, and begin_op() may be waiting for log space, since
+  // decrementing log.outstanding has decreased the amount of
+  // reserved space.
+  wakeup(&log.nclosed);
+  wakeup(&log);
+  while(log.done < p->logseq)
+    sleep(&log.done, &log.lock);
   release(&log.lock);
+}
+
+// Copy the blocks of the closed transaction, [start, end) in the
+// log, from cache into log buffers, leaving the log buffers locked.
+// Called with no FS system calls active.
+static void
+snapshot(int start, int end, struct buf **lbuf)
+{
+  int tail;
+
+  for (tail = start; tail < end; tail++) {
+    struct buf *to = bgetnoread(log.dev, log.start+tail+1); // log block
+    struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
+    memmove(to->data, from->data, BSIZE);
+    brelse(from);
+    lbuf[tail - start] = to;
+  }
+}
+
+// Write the log buffers filled by snapshot() to the log,
+// all at once, and release them.
+static void
+write_log(struct buf **lbuf, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    bstartwrite(lbuf[i]);
+  for (i = 0; i < n; i++) {
+    bwait(lbuf[i]);
+    brelse(lbuf[i]);
+  }
+}
+
+// The commit thread. Closes the running transaction once no FS
+// system call is active in it, or once it has logged a quarter
+// of the log, and commits it while the next one runs.
+static void
+committer(void)
+{
+  static struct buf *lbuf[LOGSIZE];
+  int start, end, seq;
+
+  acquire(&log.lock);
+  for (;;) {
+    while (log.lh.n == log.nclosed ||
+           (log.outstanding > 0 && log.lh.n - log.nclosed < log.size/4))
+      sleep(&log.nclosed, &log.lock);
+
+    // keep new calls out until the running ones are done.
+    log.closing = 1;
+    while (log.outstanding > 0)
+      sleep(&log.nclosed, &log.lock);
+    start = log.nclosed;
+    end = log.lh.n;
+    seq = log.seq;
+    release(&log.lock);
+
+    snapshot(start, end, lbuf);
 
-  if(do_commit){
-    // call commit w/o holding locks, since not allowed
-    // to sleep with locks.
-    commit();
     acquire(&log.lock);
-    log.committing = 0;
+    log.nclosed = end;
+    log.seq++;
+    log.closing = 0;
     wakeup(&log);
     release(&log.lock);
+
+    write_log(lbuf, end - start);  // Write modified blocks to log
+    write_head(end);  // Write header to disk -- the real commit
+
+    acquire(&log.lock);
+    log.ncommit = end;  // the flusher installs them later
+    log.done = seq;
+    wakeup(&log.done);
+    if(log.ncommit >= log.size/2 || log.full)
+      wakeup(&log.checkpointing);
+    wakeup(&log);
   }
 }
 
-// Copy modified blocks from cache to log.
+// Write every block in the log to its home location, in block
+// order, from the copies pinned in the buffer cache, and then
+// empty the log. Called with no FS system calls active, so the
+// cached copies hold exactly what was committed.
 static void
-write_log(void)
+checkpoint(void)
 {
-  int tail;
+  static int blocks[LOGSIZE], npin[LOGSIZE];
+  struct buf *dbuf[INSTALLBATCH];
+  int nb, i, j, k, n, b;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
-    struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
-    brelse(from);
-    brelse(to);
+  // sort the distinct block numbers, counting how many times
+  // each is in the log: every log slot pinned its block once.
+  nb = 0;
+  for (i = 0; i < log.lh.n; i++) {
+    b = log.lh.block[i];
+    for (j = nb; j > 0 && blocks[j-1] > b; j--)
+      ;
+    if (j > 0 && blocks[j-1] == b) {
+      npin[j-1]++;
+      continue;
+    }
+    memmove(&blocks[j+1], &blocks[j], (nb-j)*sizeof(int));
+    memmove(&npin[j+1], &npin[j], (nb-j)*sizeof(int));
+    blocks[j] = b;
+    npin[j] = 1;
+    nb++;
   }
+
+  for (i = 0; i < nb; i += n) {
+    n = nb - i;
+    if (n > INSTALLBATCH)
+      n = INSTALLBATCH;
+    for (j = 0; j < n; j++) {
+      dbuf[j] = bread(log.dev, blocks[i+j]);
+      bstartwrite(dbuf[j]);
+    }
+    for (j = 0; j < n; j++) {
+      bwait(dbuf[j]);
+      for (k = 0; k < npin[i+j]; k++)
+        bunpin(dbuf[j]);
+      brelse(dbuf[j]);
+    }
+  }
+
+  write_head(0);    // Erase the checkpointed transactions from the log
 }
 
+// The flusher thread. Checkpoints the log when half of it is
+// committed, or when begin_op() is waiting for space.
 static void
-commit()
-{
-  if (log.lh.n > 0) {
-    write_log();     // Write modified blocks from cache to log
-    write_head();    // Write header to disk -- the real commit
-    install_trans(0); // Now install writes to home locations
-    log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
+flusher(void)
+{
+  acquire(&log.lock);
+  for (;;) {
+    while (log.ncommit == 0 || (log.ncommit < log.size/2 && !log.full))
+      sleep(&log.checkpointing, &log.lock);
+    // keep new calls out, and let the commit thread
+    // commit whatever the running ones log.
+    log.checkpointing = 1;
+    while (log.outstanding > 0 || log.lh.n > log.ncommit)
+      sleep(&log, &log.lock);
+    release(&log.lock);
+
+    checkpoint();
+
+    acquire(&log.lock);
+    log.lh.n = log.nclosed = log.ncommit = 0;
+    log.checkpointing = 0;
+    log.full = 0;
+    wakeup(&log);
   }
 }
 
 // Caller has modified b->data and is done with the buffer.
 // Record the block number and pin in the cache by increasing refcnt.
-// commit()/write_log() will do the disk write.
+// The commit thread will do the disk write, and the
+// flusher's checkpoint() will unpin it.
 //
 // log_write() replaces bwrite(); a typical use is:
 //   bp = bread(...)
@@ -223,16 +423,19 @@ log_write(struct buf *b)
   int i;
 
   acquire(&log.lock);
-  if (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1)
+  if (log.lh.n >= log.size)
     panic("too big a transaction");
   if (log.outstanding < 1)
     panic("log_write outside of trans");
 
-  for (i = 0; i < log.lh.n; i++) {
+  // absorb writes within the running transaction; a block
+  // that is only in an earlier, closed one gets a new slot.
+  for (i = log.nclosed; i < log.lh.n; i++) {
     if (log.lh.block[i] == b->blockno)   // log absorption
       break;
   }
   log.lh.block[i] = b->blockno;
+  myproc()->logseq = log.seq;  // for end_opn() to wait for
   if (i == log.lh.n) {  // Add new block to log?
     bpin(b);
     log.lh.n++;
@@ -30,7 +30,12 @@ main()
     plicinithart();  // ask PLIC for device interrupts, 为每个CPU初始化plic
     binit();         // buffer cache, 初始化buf
     iinit();         // inode table, 初始化inode table
+    dcacheinit();    // directory entry cache
     fileinit();      // file table, 初始化文件表
+    textinit();      // shared program text cache
+    pcacheinit();    // file page cache
+    vmainit();       // shared mmap() regions
+    statsinit();     // statistics device
     virtio_disk_init(); // emulated hard disk, 模拟硬盘
     userinit();      // first user process, 初始化第一个用户进程
     __sync_synchronize(); // 这里防止指令重排, 相当于是一个memory barrier
@@ -28,6 +28,7 @@
 // core local interruptor (CLINT), which contains the timer.
 // 核心的计时器中断
 #define CLINT 0x2000000L
+#define CLINT_MSIP(hartid) (CLINT + 4*(hartid)) // write 1 to interrupt a hart
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
 
@@ -62,8 +63,26 @@
 //   text
 //   original data and bss
 //   fixed-size stack
-//   expandable heap
+//   expandable heap, up to MMAPBASE
 //   ...
+//   mmap() regions, allocated downwards from MMAPTOP
+//   USYSCALL (p->usyscall, read-only, for ulib.c)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define USYSCALL  (TRAPFRAME - PGSIZE)
+#define MMAPTOP   USYSCALL
+#define MMAPBASE  (MAXVA / 2)
+
+#ifndef __ASSEMBLER__
+// what the kernel tells user space through the USYSCALL page,
+// so that ulib.c can answer getpid(), uptime() and
+// clock_gettime() without a system call. the clock itself is
+// the time CSR, which user mode may read.
+struct usyscall {
+  int pid;             // process ID
+  int cpu;             // hart the process last started running on
+  uint64 mtimehz;      // time CSR cycles per second
+  uint64 tickcycles;   // time CSR cycles per clock tick
+};
+#endif
@@ -1,13 +1,18 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
+#define NLEVEL        4  // scheduler priority levels
 #define NOFILE       16  // open files per process
 #define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NINODE       200  // minimum number of in-memory i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
-#define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       2000  // size of file system in blocks, 文件系统中块的数目
+#define LOGSIZE      254  // max data blocks in on-disk log; the header block lists them
+#define NBUF         (LOGSIZE*3)  // minimum size of disk block cache; logged blocks stay pinned
+#define FSSIZE       20000  // size of file system in blocks, 文件系统中块的数目
 #define MAXPATH      128   // maximum file path name
+#define NVMA         16  // demand-paged areas per process
+#define NSHM         64  // MAP_SHARED regions in the system
+#define MTIMEHZ      10000000 // cycles of mtime per second in qemu
+#define TICKCYCLES   1000000  // cycles of mtime per clock tick and time slice; about 1/10th second in qemu
@@ -0,0 +1,435 @@
+//
+// Page cache: file contents cached in whole 4096-byte pages,
+// so that reading a file that was read recently does not go
+// through the buffer cache or the disk at all.
+//
+// Pages belong to an in-memory inode (a slot in the inode table)
+// and are named by their page number in the file. Each inode
+// keeps a list of its pages, and all pages are on one LRU list.
+// The cache takes pages from kalloc() as long as there are any;
+// when kalloc() runs dry it calls pcachereclaim() to free the
+// least recently used pages.
+//
+// readi() copies out of the cache. A miss reads the page's
+// blocks from the disk straight into the page, all at once,
+// except for blocks the buffer cache holds, which may be newer
+// than the disk if they have been logged but not yet installed.
+// readahead() starts such reads for the next pages without
+// waiting for them. writei() still writes every block through
+// the log for crash safety, and copies the new data into the
+// cached page too. vmaload() maps cached pages into mmap()ed
+// regions, so those see the same data as read() and write().
+// Pages are dropped when the file is truncated or its inode
+// table slot is recycled, and reclaimed only while unmapped.
+//
+// Locking: pcache.lock protects the lists, the hash table and
+// every pcpage's ref and nio. kalloc() may call back into
+// pcachereclaim(), so pcache.lock must never be held while
+// calling kalloc(). The contents of a page are protected by the
+// inode's sleep-lock, which readi() and writei() callers hold,
+// once no reads are in flight into it.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "buf.h"
+#include "pcache.h"
+#include "defs.h"
+
+#define NPCHASH 1021
+#define NPB     (PGSIZE / BSIZE)   // blocks per page
+
+// A kalloc()ed page of descriptors. A slab is given back to
+// kalloc() as soon as none of its descriptors are in use, so
+// that the cache shrinks all the way under memory pressure.
+struct pcslab {
+  struct pcslab *next;      // pcache.slabs list
+  int nused;
+  struct pcpage *free;      // free descriptors, chained by hnext
+  struct pcpage pg[(PGSIZE - 3*sizeof(uint64)) / sizeof(struct pcpage)];
+};
+
+// A kalloc()ed page of bufs for readahead reads, given back to
+// kalloc() when the last of them completes.
+struct pcio {
+  int n;                    // reads in flight, plus one while being filled
+  struct buf b[(PGSIZE - sizeof(uint64)) / sizeof(struct buf)];
+};
+
+struct {
+  struct spinlock lock;
+  struct pcpage *hash[NPCHASH];
+  struct pcpage lru;        // head of the LRU list
+  struct pcslab *slabs;
+  int npage;                // pages in the cache
+} pcache;
+
+static uint
+pchash(struct inode *ip, uint pgno)
+{
+  return ((uint64)ip / sizeof(struct inode) * 31 + pgno) % NPCHASH;
+}
+
+void
+pcacheinit(void)
+{
+  initlock(&pcache.lock, "pcache");
+  pcache.lru.lnext = &pcache.lru;
+  pcache.lru.lprev = &pcache.lru;
+}
+
+// Return a free descriptor, allocating a new slab of them
+// if needed. Returns 0 if out of memory.
+static struct pcpage*
+pcalloc(void)
+{
+  struct pcslab *sl;
+  struct pcpage *pg;
+
+  acquire(&pcache.lock);
+  for(sl = pcache.slabs; sl; sl = sl->next)
+    if(sl->free)
+      break;
+  if(sl == 0){
+    release(&pcache.lock);
+    if((sl = kalloc()) == 0)
+      return 0;
+    memset(sl, 0, PGSIZE);
+    for(pg = sl->pg; pg < sl->pg + NELEM(sl->pg); pg++){
+      pg->hnext = sl->free;
+      sl->free = pg;
+    }
+    acquire(&pcache.lock);
+    sl->next = pcache.slabs;
+    pcache.slabs = sl;
+  }
+  pg = sl->free;
+  sl->free = pg->hnext;
+  sl->nused++;
+  release(&pcache.lock);
+  return pg;
+}
+
+// Return a descriptor to its slab.
+// Caller must hold pcache.lock.
+static void
+pcfree(struct pcpage *pg)
+{
+  struct pcslab *sl, **pp;
+
+  sl = (struct pcslab*)PGROUNDDOWN((uint64)pg);
+  pg->ip = 0;
+  pg->data = 0;
+  pg->hnext = sl->free;
+  sl->free = pg;
+  if(--sl->nused > 0)
+    return;
+  for(pp = &pcache.slabs; *pp; pp = &(*pp)->next){
+    if(*pp == sl){
+      *pp = sl->next;
+      break;
+    }
+  }
+  kfree(sl);
+}
+
+// Unlink pg from all lists and free it.
+// Caller must hold pcache.lock.
+static void
+pcremove(struct pcpage *pg)
+{
+  struct pcpage **pp;
+
+  for(pp = &pcache.hash[pchash(pg->ip, pg->pgno)]; *pp; pp = &(*pp)->hnext){
+    if(*pp == pg){
+      *pp = pg->hnext;
+      break;
+    }
+  }
+  *pg->iprev = pg->inext;
+  if(pg->inext)
+    pg->inext->iprev = pg->iprev;
+  pg->lprev->lnext = pg->lnext;
+  pg->lnext->lprev = pg->lprev;
+
+  kfree(pg->data);
+  pcache.npage--;
+  pcfree(pg);
+}
+
+static struct pcpage*
+pclookup(struct inode *ip, uint pgno)
+{
+  struct pcpage *pg;
+
+  for(pg = pcache.hash[pchash(ip, pgno)]; pg; pg = pg->hnext)
+    if(pg->ip == ip && pg->pgno == pgno)
+      return pg;
+  return 0;
+}
+
+// Move pg to the front of the LRU list.
+static void
+pctouch(struct pcpage *pg)
+{
+  pg->lprev->lnext = pg->lnext;
+  pg->lnext->lprev = pg->lprev;
+  pg->lnext = pcache.lru.lnext;
+  pg->lprev = &pcache.lru;
+  pcache.lru.lnext->lprev = pg;
+  pcache.lru.lnext = pg;
+}
+
+// Wait until the reads into pg are done.
+// Caller must hold pcache.lock and a reference to pg.
+static void
+pcwait(struct pcpage *pg)
+{
+  while(pg->nio > 0)
+    sleep(pg, &pcache.lock);
+}
+
+// Called by virtio_disk_intr() when a read into a page is done.
+static void
+pcread_done(struct buf *b)
+{
+  struct pcpage *pg = b->priv;
+
+  acquire(&pcache.lock);
+  if(--pg->nio == 0)
+    wakeup(pg);
+  release(&pcache.lock);
+}
+
+// Drop one count from io, freeing it if that was the last.
+static void
+pcioput(struct pcio *io)
+{
+  int n;
+
+  acquire(&pcache.lock);
+  n = --io->n;
+  release(&pcache.lock);
+  if(n == 0)
+    kfree(io);
+}
+
+// Called by virtio_disk_intr() when a readahead read is done.
+static void
+pcahead_done(struct buf *b)
+{
+  pcread_done(b);
+  pcioput((struct pcio*)PGROUNDDOWN((uint64)b));
+}
+
+// Add a new page pgno of ip to the cache and start reading it,
+// using the NPB bufs at b for the blocks that must come from the
+// disk. If io is 0, the caller waits for the reads, and gets a
+// reference to the page; otherwise b is in io, and the page is
+// left to fill in the background.
+// Blocks past the end of the file read as zero.
+// Caller must hold ip->lock, and must have checked that the
+// page is not cached; nobody else can add it meanwhile.
+// Returns the page, or 0 if there is no memory for it.
+static struct pcpage*
+pcstart(struct inode *ip, uint pgno, struct buf *b, struct pcio *io)
+{
+  struct pcpage *pg;
+  uint bn, off, addr;
+  char *mem;
+  int i, n;
+
+  if((pg = pcalloc()) == 0)
+    return 0;
+  if((mem = kalloc()) == 0){
+    acquire(&pcache.lock);
+    pcfree(pg);
+    release(&pcache.lock);
+    return 0;
+  }
+
+  memset(mem, 0, PGSIZE);
+  n = 0;
+  for(off = 0; off < PGSIZE; off += BSIZE){
+    if(pgno*PGSIZE + off >= ip->size)
+      break;
+    bn = (pgno*PGSIZE + off) / BSIZE;
+    if((addr = bmap(ip, bn)) == 0)
+      break;
+    if(bpeek(ip->dev, addr, mem + off))
+      continue;
+    memset(&b[n], 0, sizeof(b[n]));
+    b[n].dev = ip->dev;
+    b[n].blockno = addr;
+    b[n].data = (uchar*)mem + off;
+    b[n].priv = pg;
+    b[n].end_io = io ? pcahead_done : pcread_done;
+    n++;
+  }
+
+  acquire(&pcache.lock);
+  pg->ip = ip;
+  pg->pgno = pgno;
+  pg->data = mem;
+  pg->ref = io ? 0 : 1;
+  pg->nio = n;
+  if(io)
+    io->n += n;
+  pg->hnext = pcache.hash[pchash(ip, pgno)];
+  pcache.hash[pchash(ip, pgno)] = pg;
+  pg->inext = ip->pages;
+  if(ip->pages)
+    ip->pages->iprev = &pg->inext;
+  pg->iprev = &ip->pages;
+  ip->pages = pg;
+  pg->lnext = pcache.lru.lnext;
+  pg->lprev = &pcache.lru;
+  pcache.lru.lnext->lprev = pg;
+  pcache.lru.lnext = pg;
+  pcache.npage++;
+  release(&pcache.lock);
+
+  // the page is in the cache, but anyone else who finds it
+  // waits in pcwait() until these reads are done.
+  for(i = 0; i < n; i++)
+    virtio_disk_submit(&b[i], 0);
+  return pg;
+}
+
+// Return page pgno of ip, reading it in if it is not cached,
+// with a reference that keeps it from being reclaimed.
+// Caller must hold ip->lock, and must call pcacheput() when done.
+// Returns 0 if there is no memory for the page.
+struct pcpage*
+pcacheget(struct inode *ip, uint pgno)
+{
+  struct pcpage *pg;
+  struct buf b[NPB];
+
+  acquire(&pcache.lock);
+  if((pg = pclookup(ip, pgno)) != 0){
+    pg->ref++;
+    pctouch(pg);
+  }
+  release(&pcache.lock);
+
+  if(pg == 0 && (pg = pcstart(ip, pgno, b, 0)) == 0)
+    return 0;
+  acquire(&pcache.lock);
+  pcwait(pg);
+  release(&pcache.lock);
+  return pg;
+}
+
+// Start reading pages [pgno, pgno+n) of ip into the cache,
+// without waiting for them. Pages already cached are skipped,
+// and reading stops if memory runs short.
+// Caller must hold ip->lock.
+void
+pcacheahead(struct inode *ip, uint pgno, uint n)
+{
+  struct pcio *io;
+  struct pcpage *pg;
+  int used;
+
+  io = 0;
+  used = 0;
+  for(; n > 0; pgno++, n--){
+    acquire(&pcache.lock);
+    pg = pclookup(ip, pgno);
+    release(&pcache.lock);
+    if(pg)
+      continue;
+    if(io == 0 || used + NPB > NELEM(io->b)){
+      if(io)
+        pcioput(io);
+      if((io = kalloc()) == 0)
+        return;
+      io->n = 1;  // until this loop is done with it
+      used = 0;
+    }
+    if(pcstart(ip, pgno, io->b + used, io) == 0)
+      break;
+    used += NPB;
+  }
+  if(io)
+    pcioput(io);
+}
+
+// Release a page returned by pcacheget().
+void
+pcacheput(struct pcpage *pg)
+{
+  acquire(&pcache.lock);
+  pg->ref--;
+  release(&pcache.lock);
+}
+
+// writei() has written n bytes at off in ip; copy them from src
+// into the cached page, if there is one.
+// Caller must hold ip->lock.
+void
+pcachewrite(struct inode *ip, uint off, char *src, uint n)
+{
+  struct pcpage *pg;
+
+  acquire(&pcache.lock);
+  if((pg = pclookup(ip, off / PGSIZE)) != 0){
+    // a readahead read still in flight would overwrite the data.
+    pg->ref++;
+    pcwait(pg);
+    pg->ref--;
+    memmove(pg->data + off % PGSIZE, src, n);
+  }
+  release(&pcache.lock);
+}
+
+// Drop all cached pages of ip, because the file is being
+// truncated or ip's table slot is being reused.
+void
+pcacheinval(struct inode *ip)
+{
+  struct pcpage *pg;
+
+  acquire(&pcache.lock);
+  while((pg = ip->pages) != 0){
+    if(pg->ref)
+      panic("pcacheinval");
+    if(pg->nio){
+      pg->ref++;
+      pcwait(pg);
+      pg->ref--;
+      continue;
+    }
+    pcremove(pg);
+  }
+  release(&pcache.lock);
+}
+
+// Free up to n of the least recently used pages that are not
+// in use, being read, or mapped into a process.
+// Called by kalloc() when it runs out of memory.
+// Returns the number of pages freed.
+int
+pcachereclaim(int n)
+{
+  struct pcpage *pg, *prev;
+  int freed = 0;
+
+  acquire(&pcache.lock);
+  for(pg = pcache.lru.lprev; pg != &pcache.lru && freed < n; pg = prev){
+    prev = pg->lprev;
+    if(pg->ref == 0 && pg->nio == 0 && krefcnt(pg->data) == 1){
+      pcremove(pg);
+      freed++;
+    }
+  }
+  release(&pcache.lock);
+  return freed;
+}
@@ -0,0 +1,13 @@
+// A page of file data in the page cache (see pcache.c).
+struct pcpage {
+  struct inode *ip;       // owner; 0 if the descriptor is free
+  uint pgno;              // page number within the file
+  char *data;             // the page itself
+  int ref;                // readers copying out of data
+  int nio;                // block reads in flight into data
+  struct pcpage *hnext;   // chain in pcache.hash[]
+  struct pcpage *inext;   // ip->pages list
+  struct pcpage **iprev;
+  struct pcpage *lnext;   // LRU list, most recent first
+  struct pcpage *lprev;
+};
@@ -79,6 +79,7 @@ pipeclose(struct pipe *pi, int writable)
   }
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
+    freelock(&pi->lock);
     kfree((char*)pi);
   } else
     release(&pi->lock);
@@ -90,6 +91,7 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
   int i = 0;
   struct proc *pr = myproc();
 
+  uvmprefault(pr->pagetable, addr, n, 0);
   acquire(&pi->lock);
   while(i < n){
     if(pi->readopen == 0 || killed(pr)){
@@ -127,6 +129,7 @@ piperead(struct pipe *pi, uint64 addr, int n)
   struct proc *pr = myproc();
   char ch;
 
+  uvmprefault(pr->pagetable, addr, n < PIPESIZE ? n : PIPESIZE, 1);
   // 首先获取管道对应的锁
   acquire(&pi->lock);
 
@@ -18,6 +18,8 @@ struct spinlock pid_lock;
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static void runnable(struct proc *p);
+static void kick(struct cpu *c, int level);
 
 extern char trampoline[]; // trampoline.S
 
@@ -28,6 +30,20 @@ extern char trampoline[]; // trampoline.S
 //? wait系统调用需要首先获取的锁
 struct spinlock wait_lock;
 
+// Wait queues for sleep() and wakeup(), by hash of chan.
+#define NWAITQ 61
+
+struct waitq {
+  struct spinlock lock;
+  struct proc *head;
+} waitq[NWAITQ];
+
+static struct waitq*
+waitqof(void *chan)
+{
+  return &waitq[(uint64)chan / 8 % NWAITQ];
+}
+
 // Allocate a page for each process's kernel stack.
 // Map it high in memory, followed by an invalid
 // guard page.
@@ -55,6 +71,8 @@ void
 procinit(void)
 {
   struct proc *p;
+  struct cpu *c;
+  struct waitq *q;
   
   //? 这两个锁的机制:
   //? nextpid锁保证获取下一个pid原子性
@@ -66,6 +84,10 @@ procinit(void)
       p->state = UNUSED; // 设置状态为Unused
       p->kstack = KSTACK((int) (p - proc)); // 设置当前进程的内核栈
   }
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    initlock(&c->rqlock, "runq");
+  for(q = waitq; q < &waitq[NWAITQ]; q++)
+    initlock(&q->lock, "waitq");
 }
 
 // Must be called with interrupts disabled,
@@ -140,6 +162,7 @@ found:
   // 如果找到了, 分配新的pid
   p->pid = allocpid();
   p->state = USED;
+  p->cpu = cpuid();
 
   // Allocate a trapframe page.
   // 分配一个陷阱页
@@ -149,6 +172,18 @@ found:
     return 0;
   }
 
+  // Allocate the page shared read-only with user space.
+  if((p->usyscall = (struct usyscall *)kalloc()) == 0){
+    freeproc(p);
+    release(&p->lock);
+    return 0;
+  }
+  memset(p->usyscall, 0, PGSIZE);
+  p->usyscall->pid = p->pid;
+  p->usyscall->cpu = p->cpu;
+  p->usyscall->mtimehz = MTIMEHZ;
+  p->usyscall->tickcycles = TICKCYCLES;
+
   // An empty user page table.
   // 为进程创建一个页表, 并且映射trampoline和trapframe
   p->pagetable = proc_pagetable(p);
@@ -180,6 +215,9 @@ freeproc(struct proc *p)
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
+  if(p->usyscall)
+    kfree((void*)p->usyscall);
+  p->usyscall = 0;
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
@@ -190,11 +228,17 @@ freeproc(struct proc *p)
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
+  p->kthread = 0;
+  p->nice = 0;
+  p->runtime = 0;
+  p->level = 0;
+  p->used = 0;
+  p->epoch = 0;
   p->state = UNUSED;
 }
 
 // Create a user page table for a given process, with no user memory,
-// but with trampoline and trapframe pages.
+// but with trampoline, trapframe and usyscall pages.
 // 为用户进程创建一个页表, 没有额外的内存空间
 // 但是保留了trampoline和trapframe
 pagetable_t
@@ -232,6 +276,16 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
+  // map the usyscall page below the trapframe, readable by
+  // user code.
+  if(mappages(pagetable, USYSCALL, PGSIZE,
+              (uint64)(p->usyscall), PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
   return pagetable;
 }
 
@@ -242,6 +296,7 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, USYSCALL, 1, 0);
   uvmfree(pagetable, sz);
 }
 
@@ -285,13 +340,15 @@ userinit(void)
   p->cwd = namei("/");
 
   // 设置进程为RUNNABLE, 等待被调度
-  p->state = RUNNABLE;
+  runnable(p);
 
   // 释放进程锁
   release(&p->lock);
 }
 
 // Grow or shrink user memory by n bytes.
+// Growing only moves p->sz; the pages are allocated
+// by vmfault() when they are first touched.
 // Return 0 on success, -1 on failure.
 int
 growproc(int n)
@@ -301,9 +358,9 @@ growproc(int n)
 
   sz = p->sz;
   if(n > 0){
-    if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
+    if(sz + n > MMAPBASE)
       return -1;
-    }
+    sz += n;
   } else if(n < 0){
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
@@ -340,6 +397,11 @@ fork(void)
   }
   // 设置页表的大小
   np->sz = p->sz;
+  if(vmacopy(p->pagetable, np->pagetable, p->vma) < 0){
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
 
   // copy saved user registers.
   // 复制所有的父进程上下文
@@ -355,6 +417,7 @@ fork(void)
     if(p->ofile[i])
       np->ofile[i] = filedup(p->ofile[i]);
   np->cwd = idup(p->cwd);
+  vmadup(np->vma, p->vma);
 
   // 复制父进程的名称
   safestrcpy(np->name, p->name, sizeof(p->name));
@@ -369,8 +432,11 @@ fork(void)
   release(&wait_lock);
 
   acquire(&np->lock);
+  // a new process starts at the top level it is allowed.
+  np->nice = p->nice;
+  np->level = np->nice;
   // 设置当前子进程进程的状态
-  np->state = RUNNABLE;
+  runnable(np);
   release(&np->lock);
   // 当前函数的返回值就是子进程的id
   return pid;
@@ -407,6 +473,9 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
+  // Write back and unmap mmap() regions and program segments.
+  vmaput(p->pagetable, p->vma);
+
   // Close all open files.
   // 关闭所有打开的文件, 底层是关闭文件的引用计数
   for(int fd = 0; fd < NOFILE; fd++){
@@ -458,6 +527,8 @@ wait(uint64 addr)
   int havekids, pid;
   struct proc *p = myproc();
 
+  if(addr != 0)
+    uvmprefault(p->pagetable, addr, sizeof(int), 1);
   acquire(&wait_lock);
 
   for(;;){
@@ -501,6 +572,274 @@ wait(uint64 addr)
   }
 }
 
+// Run queues.
+//
+// Each CPU has NLEVEL queues of the RUNNABLE processes waiting for
+// it, one per priority level, 0 being the highest; a process is on
+// a queue exactly when it is RUNNABLE, except while its CPU is
+// switching away from it. The scheduler runs the process at the
+// head of the highest non-empty level. A process that becomes
+// RUNNABLE joins the queue of the CPU it last ran on, whose caches
+// may still hold its state, or of its parent's CPU if it is new. A
+// CPU whose queues are empty steals from the CPU with the most
+// waiting processes.
+//
+// The levels form a multi-level feedback queue. A process may use
+// quantum(level) cycles of CPU time at a level, whether in one
+// slice or several, and then drops to the next level, where the
+// slices are twice as long; so processes that compute a lot sink,
+// and processes that mostly sleep, waiting for I/O or for the
+// user, stay near the top and run as soon as they wake. Once every
+// BOOSTCYCLES, every process goes back to the top, so that none
+// starves and a process that stops computing gets its priority
+// back. nice() keeps a process out of the levels above p->nice.
+//
+// Lock order: p->lock, then a run queue's lock. The scheduler
+// takes a process off a queue before it locks the process, and
+// while a process is on a queue, its level, used and epoch fields
+// belong to the queue's lock.
+
+#define QUANTUM     (TICKCYCLES / 4)   // CPU time a process gets at level 0
+#define BOOSTCYCLES (10 * TICKCYCLES)  // how often priorities are reset
+
+static uint64
+quantum(int level)
+{
+  return QUANTUM << level;
+}
+
+// Raise p to the top level it is allowed if a boost has happened
+// since it was last raised.
+static void
+boost(struct proc *p, uint epoch)
+{
+  if(p->epoch != epoch){
+    p->epoch = epoch;
+    p->level = p->nice;
+    p->used = 0;
+  }
+}
+
+// Put p, which is RUNNABLE, on the tail of its level's queue on
+// its CPU. Caller must hold p->lock.
+static void
+enqueue(struct proc *p)
+{
+  struct cpu *c = &cpus[p->cpu];
+
+  boost(p, r_time() / BOOSTCYCLES);
+  if(p->level < p->nice)
+    p->level = p->nice;
+  acquire(&c->rqlock);
+  p->rqnext = 0;
+  if(c->rqtail[p->level])
+    c->rqtail[p->level]->rqnext = p;
+  else
+    c->rqhead[p->level] = p;
+  c->rqtail[p->level] = p;
+  c->nrunnable++;
+  release(&c->rqlock);
+}
+
+// Make p RUNNABLE, put it on its CPU's run queue, and get a CPU
+// to run it. Caller must hold p->lock.
+static void
+runnable(struct proc *p)
+{
+  p->state = RUNNABLE;
+  enqueue(p);
+  kick(&cpus[p->cpu], p->level);
+}
+
+// Idle CPUs wait for an interrupt with wfi rather than polling
+// the run queues. A CPU that queues work wakes c if it is idle,
+// or else some other idle CPU that can steal the work, by sending
+// it a software interrupt (an IPI) through the CLINT. If no CPU
+// is idle and c is running a process of lower priority than the
+// new one, the IPI makes c switch to the new one at once (see
+// needresched()) rather than at the end of the slice.
+//
+// The idle flag and the run queues are used like Dekker's
+// algorithm: a CPU sets its idle flag before it looks at the
+// queues one last time, and kick() runs after the process is on
+// a queue, so either the idle CPU sees the process or kick() sees
+// the flag. wfi returns even with interrupts off if one is
+// pending, so an IPI sent just before the wfi isn't lost.
+static void
+kick(struct cpu *c, int level)
+{
+  struct cpu *v;
+  struct proc *p;
+
+  __sync_synchronize();
+  if(!c->idle){
+    for(v = cpus; v < &cpus[NCPU]; v++){
+      if(v->idle)
+        break;
+    }
+    if(v < &cpus[NCPU])
+      c = v;
+    else if((p = c->proc) == 0 || p->level <= level)
+      return;
+  }
+  *(volatile uint32*)CLINT_MSIP(c - cpus) = 1;
+}
+
+// Should the process running on this CPU give way to a waiting
+// process of higher priority? Looks without locks, since the
+// answer only decides whether to yield now or at the end of the
+// slice. Called with interrupts off.
+int
+needresched(void)
+{
+  struct cpu *c = mycpu();
+  struct proc *p = c->proc;
+  int level;
+
+  if(p == 0 || p->state != RUNNING)
+    return 0;
+  for(level = 0; level < p->level; level++){
+    if(c->rqhead[level])
+      return 1;
+  }
+  return 0;
+}
+
+// Are any processes waiting on any run queue?
+static int
+anyrunnable(void)
+{
+  struct cpu *c;
+
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(c->nrunnable > 0)
+      return 1;
+  }
+  return 0;
+}
+
+// Wait with wfi until an interrupt arrives, unless some process
+// became runnable. Returns with interrupts off; the scheduler
+// turns them on again, taking whichever interrupt woke the CPU.
+static void
+idle(struct cpu *c)
+{
+  uint64 t0;
+
+  intr_off();
+  c->idle = 1;
+  __sync_synchronize();
+  if(!anyrunnable()){
+    timerslice(0);
+    t0 = r_time();
+    asm volatile("wfi");
+    c->idletime += r_time() - t0;
+    c->nwfi++;
+  }
+  c->idle = 0;
+}
+
+// Take the process at the head of c's highest non-empty level,
+// or return 0 if c's queues are empty. The first call in each
+// boost epoch first moves every waiting process up to the top
+// level it is allowed.
+static struct proc*
+dequeue(struct cpu *c)
+{
+  struct proc *p, *next;
+  uint epoch;
+  int level;
+
+  // an unlocked look saves taking the lock of an empty queue.
+  if(c->nrunnable == 0)
+    return 0;
+  acquire(&c->rqlock);
+  epoch = r_time() / BOOSTCYCLES;
+  if(c->epoch != epoch){
+    c->epoch = epoch;
+    for(level = 1; level < NLEVEL; level++){
+      p = c->rqhead[level];
+      c->rqhead[level] = c->rqtail[level] = 0;
+      for(; p; p = next){
+        next = p->rqnext;
+        boost(p, epoch);
+        p->rqnext = 0;
+        if(c->rqtail[p->level])
+          c->rqtail[p->level]->rqnext = p;
+        else
+          c->rqhead[p->level] = p;
+        c->rqtail[p->level] = p;
+      }
+    }
+  }
+  p = 0;
+  for(level = 0; level < NLEVEL; level++){
+    if((p = c->rqhead[level]) != 0){
+      c->rqhead[level] = p->rqnext;
+      if(c->rqhead[level] == 0)
+        c->rqtail[level] = 0;
+      c->nrunnable--;
+      break;
+    }
+  }
+  release(&c->rqlock);
+  return p;
+}
+
+// Take a process from the CPU, other than c, with the most
+// waiting processes.
+static struct proc*
+steal(struct cpu *c)
+{
+  struct cpu *v, *busiest;
+
+  busiest = 0;
+  for(v = cpus; v < &cpus[NCPU]; v++){
+    if(v != c && v->nrunnable > 0 &&
+       (busiest == 0 || v->nrunnable > busiest->nrunnable))
+      busiest = v;
+  }
+  return busiest ? dequeue(busiest) : 0;
+}
+
+// Charge p for the CPU time it has just used, and move it down a
+// level if it has used up its quantum at this one.
+// Caller must hold p->lock.
+static void
+charge(struct proc *p, uint64 t)
+{
+  p->used += t;
+  p->runtime += t;
+  if(p->used >= quantum(p->level)){
+    if(p->level < NLEVEL-1)
+      p->level++;
+    p->used = 0;
+  }
+}
+
+// Called by timerintr() when the running process's slice is over
+// but no other process is waiting for this CPU: charge the process
+// for the slice, which may move it down a level, and return the
+// length of its next slice, or 0 if the CPU is running no process.
+// Called with interrupts off.
+uint64
+chargeslice(void)
+{
+  struct cpu *c = mycpu();
+  struct proc *p = c->proc;
+  uint64 now, len;
+
+  if(p == 0)
+    return 0;
+  acquire(&p->lock);
+  now = r_time();
+  charge(p, now - c->tcharged);
+  c->tcharged = now;
+  len = quantum(p->level) - p->used;
+  release(&p->lock);
+  return len;
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
@@ -521,33 +860,48 @@ scheduler(void)
   
   // 重置当前CPU上正在运行的进程
   c->proc = 0;
+  c->tstart = r_time();
   for(;;){
     // Avoid deadlock by ensuring that devices can interrupt.
     // 开中断
     intr_on();
 
     // 寻找一个可以被调度的进程
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock); // 保证原子操作
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        // 进程需要自己释放刚刚被设置的锁
-        // 交换完成之后自己再获得锁
-        p->state = RUNNING;
-        c->proc = p;
-        // 进行上下文交换, 如果是新创建的进程会直接跳转到
-        // 内核中的forkret
-        //! 到这一步为止: 线程的context中stack指向内核栈, epc指向forkret
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-      }
-      release(&p->lock);
+    if((p = dequeue(c)) == 0 && (p = steal(c)) == 0){
+      idle(c);
+      continue;
     }
+
+    acquire(&p->lock); // 保证原子操作
+    if(p->state != RUNNABLE)
+      panic("scheduler: not runnable");
+
+    // Switch to chosen process.  It is the process's job
+    // to release its lock and then reacquire it
+    // before jumping back to us.
+    // 进程需要自己释放刚刚被设置的锁
+    // 交换完成之后自己再获得锁
+    p->state = RUNNING;
+    p->cpu = c - cpus;
+    p->usyscall->cpu = p->cpu;
+    c->proc = p;
+    // the slice ends when p has used up its quantum.
+    timerslice(quantum(p->level) - p->used);
+    c->tcharged = r_time();
+    // 进行上下文交换, 如果是新创建的进程会直接跳转到
+    // 内核中的forkret
+    //! 到这一步为止: 线程的context中stack指向内核栈, epc指向forkret
+    swtch(&c->context, &p->context);
+
+    // Process is done running for now.
+    // It should have changed its p->state before coming back.
+    c->proc = 0;
+    charge(p, r_time() - c->tcharged);
+    // a process that yielded goes back on a queue only now
+    // that this CPU has switched away from it.
+    if(p->state == RUNNABLE)
+      enqueue(p);
+    release(&p->lock);
   }
 }
 
@@ -580,6 +934,7 @@ sched(void)
 }
 
 // Give up the CPU for one scheduling round.
+// The scheduler puts p back on its run queue.
 void
 yield(void)
 {
@@ -617,6 +972,58 @@ forkret(void)
   usertrapret();
 }
 
+// A kernel thread's very first scheduling by scheduler()
+// will swtch to kthreadret.
+static void
+kthreadret(void)
+{
+  struct proc *p = myproc();
+
+  // Still holding p->lock from scheduler.
+  release(&p->lock);
+
+  p->kthread();
+  panic("kthread returned");
+}
+
+// Start a kernel thread running fn, which must never return.
+// The thread has no user memory, never returns to user space,
+// and cannot be killed.
+void
+kthread(char *name, void (*fn)(void))
+{
+  struct proc *p;
+
+  if((p = allocproc()) == 0)
+    panic("kthread");
+  p->kthread = fn;
+  p->context.ra = (uint64)kthreadret;
+  safestrcpy(p->name, name, sizeof(p->name));
+  runnable(p);
+  release(&p->lock);
+}
+
+// Wait queues.
+//
+// A sleeping process is on the wait queue that its chan hashes
+// to, so that wakeup() looks only at processes that might be
+// sleeping on its chan rather than at all of proc[]. A queue's
+// lock protects its list and, together with p->lock, the chan and
+// SLEEPING state of the processes on it.
+//
+// Lock order: a wait queue's lock, then p->lock.
+
+// Take p, which is SLEEPING, off its wait queue and make it
+// RUNNABLE. Caller must hold the queue's lock and p->lock.
+static void
+unsleep(struct proc *p)
+{
+  *p->wpprev = p->wnext;
+  if(p->wnext)
+    p->wnext->wpprev = p->wpprev;
+  runnable(p);
+}
+
 /**
  * 因此sleep和wakeup的整体逻辑是, 线程等待一个变量chan的过程中释放锁进入休眠状态
  * 接着唤醒进程采用更新chan对应的值之后, wakeup所有相关的进程, 让他们重复判断
@@ -630,15 +1037,18 @@ void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct waitq *q;
   
-  // Must acquire p->lock in order to
-  // change p->state and then call sched.
-  // Once we hold p->lock, we can be
+  // Must acquire the wait queue's lock and p->lock in order
+  // to join the queue, change p->state and then call sched.
+  // Once we hold the queue's lock, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
+  // (wakeup locks it),
   // so it's okay to release lk.
 
   // 获取进程对应的锁, 从而改变进程的状态
+  q = waitqof(chan);
+  acquire(&q->lock);
   acquire(&p->lock);  //DOC: sleeplock1
   // 释放等待的锁
   release(lk);
@@ -647,6 +1057,12 @@ sleep(void *chan, struct spinlock *lk)
   // 进入休眠状态
   p->chan = chan;
   p->state = SLEEPING;
+  p->wnext = q->head;
+  if(p->wnext)
+    p->wnext->wpprev = &p->wnext;
+  p->wpprev = &q->head;
+  q->head = p;
+  release(&q->lock);
 
   // 进行调度
   sched();
@@ -666,19 +1082,21 @@ sleep(void *chan, struct spinlock *lk)
 void
 wakeup(void *chan)
 {
-  struct proc *p;
-
-  for(p = proc; p < &proc[NPROC]; p++) {
-    if(p != myproc()){
+  struct proc *p, *next;
+  struct waitq *q;
+
+  q = waitqof(chan);
+  acquire(&q->lock);
+  for(p = q->head; p; p = next){
+    next = p->wnext;
+    if(p->chan == chan){
       acquire(&p->lock);
-      // 相当于唤醒休眠的进程
-      if(p->state == SLEEPING && p->chan == chan) {
-        // 让这个线程可以重新进行调度
-        p->state = RUNNABLE;
-      }
+      // 让这个线程可以重新进行调度
+      unsleep(p);
       release(&p->lock);
     }
   }
+  release(&q->lock);
 }
 
 // Kill the process with the given pid.
@@ -689,18 +1107,28 @@ int
 kill(int pid)
 {
   struct proc *p;
+  struct waitq *q;
+  void *chan;
 
   for(p = proc; p < &proc[NPROC]; p++){
     acquire(&p->lock);
     // 找到指定的pid对应的进程
-    if(p->pid == pid){
+    if(p->pid == pid && p->kthread == 0){
       p->killed = 1;
+      chan = p->state == SLEEPING ? p->chan : 0;
+      release(&p->lock);
       // 如果进程在休眠, 就将其唤醒
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
+      if(chan){
+        // Wake process from sleep(), taking the locks in
+        // order; it may have woken up meanwhile.
+        q = waitqof(chan);
+        acquire(&q->lock);
+        acquire(&p->lock);
+        if(p->state == SLEEPING && p->chan == chan)
+          unsleep(p);
+        release(&p->lock);
+        release(&q->lock);
       }
-      release(&p->lock);
       return 0;
     }
     release(&p->lock);
@@ -727,6 +1155,34 @@ killed(struct proc *p)
   return k;
 }
 
+// Keep process pid, or the caller if pid is 0, out of the
+// scheduler's levels above n, so that it gets the CPU only when
+// no process with a higher level is waiting for it.
+// Returns the old value, or -1 if there is no such process or n
+// is not a level.
+int
+nice(int pid, int n)
+{
+  struct proc *p;
+  int old;
+
+  if(n < 0 || n >= NLEVEL)
+    return -1;
+  if(pid == 0)
+    pid = myproc()->pid;
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED){
+      old = p->nice;
+      p->nice = n;
+      release(&p->lock);
+      return old;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
 // Copy to either a user address, or kernel address,
 // depending on usr_dst.
 // Returns 0 on success, -1 on error.
@@ -782,7 +1238,28 @@ procdump(void)
       state = states[p->state];
     else
       state = "???";
-    printf("%d %s %s", p->pid, state, p->name);
+    printf("%d %s %s level %d nice %d cpu %dms", p->pid, state, p->name,
+           p->level, p->nice, (int)(p->runtime / (MTIMEHZ / 1000)));
     printf("\n");
   }
 }
+
+// Append each CPU's idle time to the statistics report.
+int
+idlestats(char *buf, int sz)
+{
+  struct cpu *c;
+  uint64 t;
+  int n;
+
+  n = snprintf(buf, sz, "--- idle stats\n");
+  for(c = cpus; c < &cpus[NCPU] && n < sz; c++){
+    if(c->tstart == 0)
+      continue;  // never started
+    t = r_time() - c->tstart;
+    n += snprintf(buf + n, sz - n, "cpu %d: idle %d%% (%l of %l cycles) #wfi %d #ipi %d\n",
+                  (int)(c - cpus), (int)(t ? c->idletime * 100 / t : 0),
+                  c->idletime, t, c->nwfi, c->nipi);
+  }
+  return n < sz ? n : sz - 1;
+}
@@ -24,6 +24,17 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  struct spinlock rqlock;     // protects the run queue
+  struct proc *rqhead[NLEVEL]; // RUNNABLE processes waiting for this cpu, by level
+  struct proc *rqtail[NLEVEL];
+  int nrunnable;              // length of the run queue
+  uint epoch;                 // boost epoch the queue was last boosted in
+  int idle;                   // waiting in wfi; send an IPI to wake it
+  uint64 tstart;              // time (in cycles) scheduler() started
+  uint64 tcharged;            // time the running process was charged up to
+  uint64 idletime;            // cycles spent waiting in wfi
+  uint nwfi;                  // times it waited
+  uint nipi;                  // IPIs received
 };
 
 extern struct cpu cpus[NCPU];
@@ -79,6 +90,22 @@ struct trapframe {
   /* 280 */ uint64 t6;
 };
 
+// A range of user memory whose pages are filled in on first
+// touch (see vma.c): an ELF segment or an mmap() region.
+struct vma {
+  uint64 start;                // first virtual address, page-aligned
+  uint64 end;                  // one past the last virtual address; 0 if free
+  struct inode *ip;            // backing file, or 0 for anonymous memory
+  uint off;                    // file offset of start
+  uint filesz;                 // bytes read from the file; the rest is zero
+  int perm;                    // PTE_R/W/X for the pages
+  int flags;                   // VMA_*
+  struct shm *shm;             // MAP_SHARED pages not in the file
+};
+
+#define VMA_MMAP    0x1        // made by mmap(); lies above p->sz
+#define VMA_SHARED  0x2        // writes are shared and go back to the file
+
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
@@ -91,6 +118,23 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  void (*kthread)(void);       // If non-zero, kernel thread's function
+  int cpu;                     // CPU whose run queue p goes on
+  int nice;                    // Highest priority level p may have
+  uint64 runtime;              // CPU time used, in cycles
+
+  // p->lock, or while p is on a run queue, the queue's rqlock,
+  // must be held when using these:
+  int level;                   // Priority level; 0 is the highest
+  uint64 used;                 // CPU time used at this level
+  uint epoch;                  // Boost epoch p was last raised in
+
+  // the run queue's rqlock must be held when using this:
+  struct proc *rqnext;         // Next process on the run queue
+
+  // the wait queue's lock must be held when using these:
+  struct proc *wnext;          // Next process sleeping in the same bucket
+  struct proc **wpprev;
 
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
@@ -100,8 +144,11 @@ struct proc {
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
+  struct usyscall *usyscall;   // read-only page for user space at USYSCALL
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  struct vma vma[NVMA];        // Demand-paged areas
+  int logseq;                  // Last log transaction p logged blocks in
   char name[16];               // Process name (debugging)
 };
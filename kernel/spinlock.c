@@ -8,12 +8,47 @@
 #include "proc.h"
 #include "defs.h"
 
+// Every lock is on this list so that the statistics device
+// can report which ones are contended.
+static struct spinlock lock_locks;
+static struct spinlock *locks;
+
 void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
   lk->locked = 0;
   lk->cpu = 0;
+  lk->n = 0;
+  lk->nts = 0;
+  lk->next = 0;
+  lk->pprev = 0;
+  if(lk == &lock_locks)
+    return;
+  if(lock_locks.name == 0)
+    initlock(&lock_locks, "locks");
+  acquire(&lock_locks);
+  lk->next = locks;
+  if(locks)
+    locks->pprev = &lk->next;
+  lk->pprev = &locks;
+  locks = lk;
+  release(&lock_locks);
+}
+
+// Forget a lock whose memory is about to be freed.
+void
+freelock(struct spinlock *lk)
+{
+  acquire(&lock_locks);
+  if(lk->pprev){
+    *lk->pprev = lk->next;
+    if(lk->next)
+      lk->next->pprev = lk->pprev;
+    lk->next = 0;
+    lk->pprev = 0;
+  }
+  release(&lock_locks);
 }
 
 // Acquire the lock.
@@ -29,8 +64,9 @@ acquire(struct spinlock *lk)
   //   a5 = 1
   //   s1 = &lk->locked
   //   amoswap.w.aq a5, a5, (s1)
+  __sync_fetch_and_add(&lk->n, 1);
   while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+    __sync_fetch_and_add(&lk->nts, 1);
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -111,3 +147,44 @@ pop_off(void)
   if(c->noff == 0 && c->intena) // 如果noff归零, 将中断设置为之前的状态
     intr_on();
 }
+
+// Print the NSTATLOCK most contended locks into buf, followed by
+// the total number of spins over all locks.
+// Returns the number of characters written.
+#define NSTATLOCK 10
+
+int
+statslock(char *buf, int sz)
+{
+  struct spinlock *top[NSTATLOCK];
+  struct spinlock *lk;
+  uint64 tot;
+  int j, k, n;
+
+  memset(top, 0, sizeof(top));
+  tot = 0;
+  acquire(&lock_locks);
+  for(lk = locks; lk; lk = lk->next){
+    tot += lk->nts;
+    if(lk->nts == 0)
+      continue;
+    for(j = 0; j < NSTATLOCK; j++){
+      if(top[j] == 0 || lk->nts > top[j]->nts){
+        for(k = NSTATLOCK-1; k > j; k--)
+          top[k] = top[k-1];
+        top[j] = lk;
+        break;
+      }
+    }
+  }
+
+  n = snprintf(buf, sz, "--- lock contention stats\n");
+  for(j = 0; j < NSTATLOCK && top[j] && n < sz; j++){
+    n += snprintf(buf + n, sz - n, "lock: %s: #test-and-set %d #acquire() %d\n",
+                  top[j]->name, top[j]->nts, top[j]->n);
+  }
+  if(n < sz)
+    n += snprintf(buf + n, sz - n, "tot= %l\n", tot);
+  release(&lock_locks);
+  return n < sz ? n : sz - 1;
+}
@@ -5,5 +5,11 @@ struct spinlock {
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+
+  // For the statistics device:
+  uint n;            // Number of acquire()s.
+  uint nts;          // Number of spins waiting for the lock.
+  struct spinlock *next;    // list of all locks
+  struct spinlock **pprev;
 };
 
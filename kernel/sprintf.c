@@ -0,0 +1,100 @@
+//
+// formatted output to a buffer -- snprintf.
+//
+
+#include <stdarg.h>
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "defs.h"
+
+static char digits[] = "0123456789abcdef";
+
+// Append c to buf unless it is full. Returns the new length.
+static int
+sputc(char *buf, int sz, int n, char c)
+{
+  if(n < sz - 1)
+    buf[n] = c;
+  return n + 1;
+}
+
+static int
+sprintint(char *buf, int sz, int n, long xx, int base, int sign)
+{
+  char tmp[24];
+  int i;
+  uint64 x;
+
+  if(sign && (sign = xx < 0))
+    x = -xx;
+  else
+    x = xx;
+
+  i = 0;
+  do {
+    tmp[i++] = digits[x % base];
+  } while((x /= base) != 0);
+
+  if(sign)
+    tmp[i++] = '-';
+
+  while(--i >= 0)
+    n = sputc(buf, sz, n, tmp[i]);
+  return n;
+}
+
+// Print to buf, which holds sz bytes, and always terminate it.
+// Only understands %d, %l (a 64-bit %d), %x, %s.
+// Returns the number of characters written, not counting the
+// terminating 0, or what would have been written had buf been
+// big enough.
+int
+snprintf(char *buf, int sz, char *fmt, ...)
+{
+  va_list ap;
+  int i, c, n;
+  char *s;
+
+  va_start(ap, fmt);
+  n = 0;
+  for(i = 0; (c = fmt[i] & 0xff) != 0; i++){
+    if(c != '%'){
+      n = sputc(buf, sz, n, c);
+      continue;
+    }
+    c = fmt[++i] & 0xff;
+    if(c == 0)
+      break;
+    switch(c){
+    case 'd':
+      n = sprintint(buf, sz, n, va_arg(ap, int), 10, 1);
+      break;
+    case 'l':
+      n = sprintint(buf, sz, n, va_arg(ap, uint64), 10, 1);
+      break;
+    case 'x':
+      n = sprintint(buf, sz, n, va_arg(ap, uint), 16, 0);
+      break;
+    case 's':
+      if((s = va_arg(ap, char*)) == 0)
+        s = "(null)";
+      for(; *s; s++)
+        n = sputc(buf, sz, n, *s);
+      break;
+    case '%':
+      n = sputc(buf, sz, n, '%');
+      break;
+    default:
+      // Print unknown % sequence to draw attention.
+      n = sputc(buf, sz, n, '%');
+      n = sputc(buf, sz, n, c);
+      break;
+    }
+  }
+  va_end(ap);
+  if(sz > 0)
+    buf[n < sz ? n : sz - 1] = 0;
+  return n;
+}
@@ -16,8 +16,10 @@ __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 // 每一个CPU中Timer中断对应的区域
 // scratch[0..2] : space for timervec to save registers.
 // scratch[3] : address of CLINT MTIMECMP register.
-// scratch[4] : desired interval (in cycles) between timer interrupts.
-uint64 timer_scratch[NCPU][5];
+// scratch[4] : set by timervec when the timer goes off, so that
+//              devintr() can tell a timer interrupt from an IPI.
+// scratch[5] : address of CLINT MSIP register.
+uint64 timer_scratch[NCPU][6];
 
 // assembly code in kernelvec.S for machine-mode timer interrupt.
 extern void timervec();
@@ -68,7 +70,8 @@ start()
   asm volatile("mret");
 }
 
-// arrange to receive timer interrupts.
+// arrange to receive timer interrupts, one for each time the
+// kernel programs MTIMECMP.
 // they will arrive in machine mode at
 // at timervec in kernelvec.S,
 // which turns them into software interrupts for
@@ -81,18 +84,20 @@ timerinit()
   // 获取CPU的id
   int id = r_mhartid();
 
-  // ask the CLINT for a timer interrupt.
-  int interval = 1000000; // cycles; about 1/10th second in qemu. 定时器的中断周期
-  // 也就是说timer中断的触发机制采用的时比较值, 当前值 + Interval
-  *(uint64*)CLINT_MTIMECMP(id) = *(uint64*)CLINT_MTIME + interval;
+  // no timer interrupt until the kernel asks for one; timer.c
+  // programs MTIMECMP for each deadline.
+  // 也就是说timer中断的触发机制采用的时比较值
+  *(uint64*)CLINT_MTIMECMP(id) = 0xffffffffffffffffULL;
 
   // prepare information in scratch[] for timervec.
   // scratch[0..2] : space for timervec to save registers.
   // scratch[3] : address of CLINT MTIMECMP register.
-  // scratch[4] : desired interval (in cycles) between timer interrupts.
+  // scratch[4] : tick pending.
+  // scratch[5] : address of CLINT MSIP register.
   uint64 *scratch = &timer_scratch[id][0];
   scratch[3] = CLINT_MTIMECMP(id);
-  scratch[4] = interval;
+  scratch[4] = 0;
+  scratch[5] = CLINT_MSIP(id);
   w_mscratch((uint64)scratch);
 
   // set the machine-mode trap handler.
@@ -103,7 +108,13 @@ timerinit()
   // 开启M mode下的中断
   w_mstatus(r_mstatus() | MSTATUS_MIE);
 
-  // enable machine-mode timer interrupts.
+  // enable machine-mode timer interrupts, and the software
+  // interrupts other harts send to wake this one.
   // 开始计时器中断
-  w_mie(r_mie() | MIE_MTIE);
+  w_mie(r_mie() | MIE_MTIE | MIE_MSIE);
+
+  // let supervisor mode read the time CSR, and user mode too,
+  // for the clock in ulib.c.
+  w_mcounteren(r_mcounteren() | 2);
+  w_scounteren(r_scounteren() | 2);
 }
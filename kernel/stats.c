@@ -0,0 +1,65 @@
+//
+// The statistics device: reading it returns a text report of
+// kernel counters: the most contended spinlocks, how often
+// the directory entry cache found a name, how long each CPU
+// has been idle, and how many timer interrupts each has taken.
+// The report is made when a read starts at the beginning, and
+// later reads continue through it until end of file.
+//
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "riscv.h"
+#include "defs.h"
+#include "proc.h"
+
+#define STATSBUFSZ 4096
+
+static struct {
+  struct spinlock lock;
+  char buf[STATSBUFSZ];
+  int sz;
+  int off;
+} stats;
+
+int
+statsread(int user_dst, uint64 dst, int n)
+{
+  int m;
+
+  if(user_dst)
+    uvmprefault(myproc()->pagetable, dst, n < STATSBUFSZ ? n : STATSBUFSZ, 1);
+  acquire(&stats.lock);
+  if(stats.sz == 0){
+    stats.sz = statslock(stats.buf, STATSBUFSZ);
+    stats.sz += dcachestats(stats.buf + stats.sz, STATSBUFSZ - stats.sz);
+    stats.sz += idlestats(stats.buf + stats.sz, STATSBUFSZ - stats.sz);
+    stats.sz += timerstats(stats.buf + stats.sz, STATSBUFSZ - stats.sz);
+  }
+  m = stats.sz - stats.off;
+  if(m > 0){
+    if(m > n)
+      m = n;
+    if(either_copyout(user_dst, dst, stats.buf + stats.off, m) != -1)
+      stats.off += m;
+  } else {
+    // end of the report; the next read starts a new one.
+    m = 0;
+    stats.sz = 0;
+    stats.off = 0;
+  }
+  release(&stats.lock);
+  return m;
+}
+
+void
+statsinit(void)
+{
+  initlock(&stats.lock, "stats");
+  devsw[STATS].read = statsread;
+  devsw[STATS].write = 0;
+}
@@ -139,16 +139,16 @@ sys_link(void)
   if(argstr(0, old, MAXPATH) < 0 || argstr(1, new, MAXPATH) < 0)
     return -1;
 
-  begin_op();
+  begin_opn(DIROPBLOCKS);
   if((ip = namei(old)) == 0){
-    end_op();
+    end_opn(DIROPBLOCKS);
     return -1;
   }
 
   ilock(ip);
   if(ip->type == T_DIR){
     iunlockput(ip);
-    end_op();
+    end_opn(DIROPBLOCKS);
     return -1;
   }
 
@@ -166,7 +166,7 @@ sys_link(void)
   iunlockput(dp);
   iput(ip);
 
-  end_op();
+  end_opn(DIROPBLOCKS);
 
   return 0;
 
@@ -175,7 +175,7 @@ bad:
   ip->nlink--;
   iupdate(ip);
   iunlockput(ip);
-  end_op();
+  end_opn(DIROPBLOCKS);
   return -1;
 }
 
@@ -232,6 +232,7 @@ sys_unlink(void)
   memset(&de, 0, sizeof(de));
   if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
     panic("unlink: writei");
+  dcacheput(dp, name, 0);
   if(ip->type == T_DIR){
     dp->nlink--;
     iupdate(dp);
@@ -341,7 +342,7 @@ sys_open(void)
   int fd, omode;
   struct file *f;
   struct inode *ip;
-  int n;
+  int n, nblk;
 
   // file的rw mode
   argint(1, &omode);
@@ -349,21 +350,23 @@ sys_open(void)
   if((n = argstr(0, path, MAXPATH)) < 0)
     return -1;
 
-  begin_op(); // 这一个操作是为了满足当前fs的log已经提交, 可以理解这里实际上就是一个事务
+  // creating a file may split directory leaves.
+  nblk = (omode & O_CREATE) ? DIROPBLOCKS : MAXOPBLOCKS;
+  begin_opn(nblk); // 这一个操作是为了满足当前fs的log已经提交, 可以理解这里实际上就是一个事务
 
   // 如果创建文件
   if(omode & O_CREATE){
     // 创建文件: 本质上是创建inode, 同时将之挂载到其父目录上
     ip = create(path, T_FILE, 0, 0);
     if(ip == 0){
-      end_op();
+      end_opn(nblk);
       return -1;
     }
   // 读写操作
   } else {
     // 找到path对应的inode
     if((ip = namei(path)) == 0){
-      end_op();
+      end_opn(nblk);
       return -1;
     }
     // 锁定对应的inode
@@ -371,7 +374,7 @@ sys_open(void)
     // 如果inode对应一个目录
     if(ip->type == T_DIR && omode != O_RDONLY){
       iunlockput(ip);
-      end_op();
+      end_opn(nblk);
       return -1;
     }
   }
@@ -379,7 +382,15 @@ sys_open(void)
   // 如果inode是一个设备
   if(ip->type == T_DEVICE && (ip->major < 0 || ip->major >= NDEV)){
     iunlockput(ip);
-    end_op();
+    end_opn(nblk);
+    return -1;
+  }
+
+  // a running program can't be truncated; do it before
+  // allocating the file, which would be awkward to undo.
+  if((omode & O_TRUNC) && ip->type == T_FILE && itrunc(ip) < 0){
+    iunlockput(ip);
+    end_opn(nblk);
     return -1;
   }
 
@@ -388,7 +399,7 @@ sys_open(void)
     if(f)
       fileclose(f);
     iunlockput(ip);
-    end_op();
+    end_opn(nblk);
     return -1;
   }
 
@@ -399,18 +410,15 @@ sys_open(void)
   } else {
     f->type = FD_INODE;
     f->off = 0;
+    f->ranext = f->raend = f->rawin = 0;
   }
   // 设置文件对应的内容
   f->ip = ip;
   f->readable = !(omode & O_WRONLY);
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
 
-  if((omode & O_TRUNC) && ip->type == T_FILE){
-    itrunc(ip);
-  }
-
   iunlock(ip);
-  end_op();
+  end_opn(nblk);
 
   return fd;
 }
@@ -421,13 +429,13 @@ sys_mkdir(void)
   char path[MAXPATH];
   struct inode *ip;
 
-  begin_op();
+  begin_opn(DIROPBLOCKS);
   if(argstr(0, path, MAXPATH) < 0 || (ip = create(path, T_DIR, 0, 0)) == 0){
-    end_op();
+    end_opn(DIROPBLOCKS);
     return -1;
   }
   iunlockput(ip);
-  end_op();
+  end_opn(DIROPBLOCKS);
   return 0;
 }
 
@@ -438,16 +446,16 @@ sys_mknod(void)
   char path[MAXPATH];
   int major, minor;
 
-  begin_op();
+  begin_opn(DIROPBLOCKS);
   argint(1, &major);
   argint(2, &minor);
   if((argstr(0, path, MAXPATH)) < 0 ||
      (ip = create(path, T_DEVICE, major, minor)) == 0){
-    end_op();
+    end_opn(DIROPBLOCKS);
     return -1;
   }
   iunlockput(ip);
-  end_op();
+  end_opn(DIROPBLOCKS);
   return 0;
 }
 
@@ -566,3 +574,60 @@ sys_pipe(void)
   }
   return 0;
 }
+
+// mmap(addr, len, prot, flags, fd, off)
+// addr is only a hint and is ignored; the kernel picks
+// the address. Pages are read in lazily by vmfault().
+uint64
+sys_mmap(void)
+{
+  uint64 addr;
+  int len, prot, flags, off, perm;
+  struct file *f;
+  struct inode *ip = 0;
+
+  argaddr(0, &addr);
+  argint(1, &len);
+  argint(2, &prot);
+  argint(3, &flags);
+  argint(5, &off);
+  if(len <= 0 || off < 0 || off % PGSIZE != 0)
+    return -1;
+  if(((flags & MAP_SHARED) != 0) == ((flags & MAP_PRIVATE) != 0))
+    return -1;
+  if((prot & (PROT_READ|PROT_WRITE|PROT_EXEC)) == 0)
+    return -1;
+
+  // RISC-V has no write-only or execute-only pages
+  // that are useful here, so mappings are always readable.
+  perm = PTE_R;
+  if(prot & PROT_WRITE)
+    perm |= PTE_W;
+  if(prot & PROT_EXEC)
+    perm |= PTE_X;
+
+  if((flags & MAP_ANONYMOUS) == 0){
+    if(argfd(4, 0, &f) < 0)
+      return -1;
+    if(f->type != FD_INODE || !f->readable)
+      return -1;
+    if((flags & MAP_SHARED) && (prot & PROT_WRITE) && !f->writable)
+      return -1;
+    ip = f->ip;
+  }
+
+  return vmamap(len, perm, (flags & MAP_SHARED) ? VMA_SHARED : 0, ip, off);
+}
+
+uint64
+sys_munmap(void)
+{
+  uint64 addr;
+  int len;
+
+  argaddr(0, &addr);
+  argint(1, &len);
+  if(len <= 0)
+    return -1;
+  return vmaunmap(addr, len);
+}
@@ -54,20 +54,11 @@ uint64
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   argint(0, &n);
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(killed(myproc())){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  if(n < 0)
+    n = 0;
+  return timersleep(r_time() + (uint64)n * TICKCYCLES);
 }
 
 // kill一个进程, 核心思路:
@@ -82,15 +73,44 @@ sys_kill(void)
   return kill(pid);
 }
 
-// return how many clock tick interrupts have occurred
+uint64
+sys_nice(void)
+{
+  int pid, n;
+
+  argint(0, &pid);
+  argint(1, &n);
+  return nice(pid, n);
+}
+
+// return how many clock ticks have passed
 // since start.
 uint64
 sys_uptime(void)
 {
-  uint xticks;
+  return tickcount();
+}
+
+// Store the time since boot, in nanoseconds, at the user
+// address in argument 0. Unlike uptime(), which counts ticks,
+// this has the resolution of the CLINT's mtime counter.
+uint64
+sys_clock_gettime(void)
+{
+  uint64 addr, ns;
+
+  argaddr(0, &addr);
+  ns = timens();
+  if(copyout(myproc()->pagetable, addr, (char*)&ns, sizeof(ns)) < 0)
+    return -1;
+  return 0;
+}
+
+uint64
+sys_nanosleep(void)
+{
+  uint64 ns;
 
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
-  return xticks;
+  argaddr(0, &ns);
+  return timernanosleep(ns);
 }
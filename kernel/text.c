@@ -0,0 +1,176 @@
+//
+// Cache of read-only program pages, so that processes running
+// the same binary share one physical copy of its text.
+//
+// Pages are named by (dev, inum, file offset, length). A cached
+// page is mapped with PTE_TEXT; its kalloc() reference count is
+// the number of page tables that map it, and the cache itself
+// holds no reference. textput() drops a mapping and forgets the
+// page when the last one goes, so the memory is freed as soon as
+// the last process using it exits or execs something else.
+//
+// writei() and itrunc() refuse to change a file that some process
+// is running (ip->nexec > 0), since vmaload() reads its pages
+// from the file only when they are first touched. Changing a
+// file that is not running forgets any pages still cached.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "defs.h"
+
+#define NTEXT     256  // cached pages
+#define NTEXTHASH 61   // hash buckets, for both indexes
+
+struct textpage {
+  uint dev;
+  uint inum;
+  uint off;                // file offset of the page's contents
+  uint len;                // bytes read from the file; the rest is zero
+  char *pa;                // 0 if the slot is free
+  struct textpage *next;   // chain in text.file[]
+  struct textpage *pnext;  // chain in text.phys[]
+};
+
+struct {
+  struct spinlock lock;
+  struct textpage page[NTEXT];
+  struct textpage *file[NTEXTHASH];  // by (dev, inum)
+  struct textpage *phys[NTEXTHASH];  // by physical address
+} text;
+
+static uint
+filehash(uint dev, uint inum)
+{
+  return (dev * 31 + inum) % NTEXTHASH;
+}
+
+static uint
+physhash(char *pa)
+{
+  return ((uint64)pa / PGSIZE) % NTEXTHASH;
+}
+
+void
+textinit(void)
+{
+  initlock(&text.lock, "text");
+}
+
+// Unlink t from both indexes and free its slot.
+// Caller must hold text.lock.
+static void
+textremove(struct textpage *t)
+{
+  struct textpage **tp;
+
+  for(tp = &text.file[filehash(t->dev, t->inum)]; *tp; tp = &(*tp)->next){
+    if(*tp == t){
+      *tp = t->next;
+      break;
+    }
+  }
+  for(tp = &text.phys[physhash(t->pa)]; *tp; tp = &(*tp)->pnext){
+    if(*tp == t){
+      *tp = t->pnext;
+      break;
+    }
+  }
+  t->pa = 0;
+}
+
+// Return a page holding len bytes of ip at off followed by zeroes,
+// shared with any other process that has the same page mapped.
+// The caller gets a reference to the page and should map it with
+// PTE_TEXT, and hand it back with textput().
+// Caller must hold the inode lock. Returns 0 on failure.
+char*
+textget(struct inode *ip, uint off, uint len)
+{
+  struct textpage *t;
+  char *mem;
+  uint h;
+
+  h = filehash(ip->dev, ip->inum);
+  acquire(&text.lock);
+  for(t = text.file[h]; t; t = t->next){
+    if(t->dev == ip->dev && t->inum == ip->inum && t->off == off && t->len == len){
+      krefinc(t->pa);
+      release(&text.lock);
+      return t->pa;
+    }
+  }
+  release(&text.lock);
+
+  // Not cached. Nobody else can add this page meanwhile,
+  // since that would need the inode lock.
+  if((mem = kalloc()) == 0)
+    return 0;
+  memset(mem, 0, PGSIZE);
+  if(readi(ip, 0, (uint64)mem, off, len) != len){
+    kfree(mem);
+    return 0;
+  }
+
+  acquire(&text.lock);
+  for(t = text.page; t < text.page + NTEXT; t++){
+    if(t->pa == 0){
+      t->dev = ip->dev;
+      t->inum = ip->inum;
+      t->off = off;
+      t->len = len;
+      t->pa = mem;
+      t->next = text.file[h];
+      text.file[h] = t;
+      t->pnext = text.phys[physhash(mem)];
+      text.phys[physhash(mem)] = t;
+      break;
+    }
+  }
+  // If the cache is full the page is simply private.
+  release(&text.lock);
+  return mem;
+}
+
+// Drop one mapping of a PTE_TEXT page.
+// The reference is dropped under text.lock, so that the last one
+// and forgetting the page happen together: textget() cannot find
+// the page once it is free, and two processes dropping the last
+// two references at once cannot both leave it in the cache.
+void
+textput(char *pa)
+{
+  struct textpage *t;
+
+  acquire(&text.lock);
+  if(kput(pa) == 0){
+    for(t = text.phys[physhash(pa)]; t; t = t->pnext){
+      if(t->pa == pa){
+        textremove(t);
+        break;
+      }
+    }
+  }
+  release(&text.lock);
+}
+
+// Forget the cached pages of ip, whose contents are changing.
+void
+textinval(struct inode *ip)
+{
+  struct textpage *t, *next;
+
+  acquire(&text.lock);
+  for(t = text.file[filehash(ip->dev, ip->inum)]; t; t = next){
+    next = t->next;
+    if(t->dev == ip->dev && t->inum == ip->inum)
+      textremove(t);
+  }
+  release(&text.lock);
+}
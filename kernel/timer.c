@@ -0,0 +1,226 @@
+//
+// One-shot timers.
+//
+// There is no periodic clock interrupt. Each hart programs its
+// CLINT mtimecmp register for the earliest of
+//  - the first deadline on its list of sleeping processes, and
+//  - the end of the running process's time slice,
+// so an idle hart with nothing to wait for gets no timer
+// interrupts at all, and a sleep ends when its deadline passes
+// rather than at the next tick after it.
+//
+// A deadline is a struct timer on the stack of the process that
+// is sleeping until it. Each hart keeps its deadlines in a list
+// sorted by time, which is short (at most one entry per
+// process), and a process adds its deadline to the list of the
+// hart it is running on, since a hart can only be sure its own
+// mtimecmp is programmed correctly.
+//
+// Times are in cycles of mtime, as returned by r_time().
+// Clock ticks, which sleep() and uptime() count in, are now just
+// TICKCYCLES cycles of mtime.
+//
+// Lock order: a hart's timer list lock, then the wait queue and
+// process locks that wakeup() takes.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NEVER 0xffffffffffffffffULL
+#define NSEC  1000000000ULL   // nanoseconds per second
+
+struct timer {
+  uint64 when;            // deadline
+  struct timer *next;
+  struct timer **pprev;   // 0 once the deadline has passed
+};
+
+struct {
+  struct spinlock lock;
+  struct timer *head;     // sorted by when
+  uint64 first;           // head's deadline, or NEVER
+  uint64 slice;           // end of the running process's time slice
+  uint nintr;             // timer interrupts taken
+} tq[NCPU];
+
+void
+timersinit(void)
+{
+  int i;
+
+  for(i = 0; i < NCPU; i++){
+    initlock(&tq[i].lock, "timer");
+    tq[i].first = NEVER;
+    tq[i].slice = NEVER;
+  }
+}
+
+// Program this hart's mtimecmp for its next deadline.
+// Caller must have interrupts off.
+static void
+timerprogram(void)
+{
+  int id = cpuid();
+  uint64 when;
+
+  when = tq[id].first;
+  if(tq[id].slice < when)
+    when = tq[id].slice;
+  *(volatile uint64*)CLINT_MTIMECMP(id) = when;
+}
+
+// Start a time slice of len cycles for the process this hart is
+// about to run, or, if len is 0, stop slicing because the hart is
+// idle. Caller must have interrupts off.
+void
+timerslice(uint64 len)
+{
+  int id = cpuid();
+
+  tq[id].slice = len ? r_time() + len : NEVER;
+  timerprogram();
+}
+
+// Clock ticks since boot.
+uint
+tickcount(void)
+{
+  return r_time() / TICKCYCLES;
+}
+
+// Nanoseconds since boot, from mtime.
+uint64
+timens(void)
+{
+  uint64 t = r_time();
+
+  return t / MTIMEHZ * NSEC + t % MTIMEHZ * NSEC / MTIMEHZ;
+}
+
+// Sleep for at least ns nanoseconds, or until the process is
+// killed. Returns 0, or -1 if killed.
+int
+timernanosleep(uint64 ns)
+{
+  uint64 now, when;
+
+  // round up, so as never to sleep too short.
+  now = r_time();
+  when = now + ns / NSEC * MTIMEHZ + (ns % NSEC * MTIMEHZ + NSEC - 1) / NSEC;
+  if(when < now)
+    when = NEVER;
+  return timersleep(when);
+}
+
+// Sleep until mtime reaches when, or the process is killed.
+// Returns 0, or -1 if killed.
+int
+timersleep(uint64 when)
+{
+  struct proc *p = myproc();
+  struct timer t, **pp;
+  int id, r;
+
+  if(when <= r_time())
+    return 0;
+
+  // stay on this hart until its list is locked.
+  push_off();
+  id = cpuid();
+  acquire(&tq[id].lock);
+  pop_off();
+
+  t.when = when;
+  for(pp = &tq[id].head; *pp && (*pp)->when <= when; pp = &(*pp)->next)
+    ;
+  t.next = *pp;
+  if(t.next)
+    t.next->pprev = &t.next;
+  t.pprev = pp;
+  *pp = &t;
+  if(pp == &tq[id].head){
+    tq[id].first = when;
+    timerprogram();
+  }
+
+  r = 0;
+  while(t.pprev){
+    if(killed(p)){
+      if(t.next)
+        t.next->pprev = t.pprev;
+      *t.pprev = t.next;
+      tq[id].first = tq[id].head ? tq[id].head->when : NEVER;
+      r = -1;
+      break;
+    }
+    sleep(&t, &tq[id].lock);
+  }
+  release(&tq[id].lock);
+  return r;
+}
+
+// Handle a timer interrupt on this hart: wake the processes whose
+// deadlines have passed, and reprogram mtimecmp. Returns 1 if the
+// running process's time slice is over and other processes are
+// waiting for this hart, 0 if not.
+int
+timerintr(void)
+{
+  struct cpu *c = mycpu();
+  int id = cpuid();
+  struct timer *t;
+  uint64 now, len;
+  int preempt;
+
+  acquire(&tq[id].lock);
+  tq[id].nintr++;
+  now = r_time();
+  while((t = tq[id].head) != 0 && t->when <= now){
+    tq[id].head = t->next;
+    if(t->next)
+      t->next->pprev = &tq[id].head;
+    t->pprev = 0;
+    wakeup(t);
+  }
+  tq[id].first = t ? t->when : NEVER;
+  release(&tq[id].lock);
+
+  // a process whose slice is over gives way to any process
+  // waiting for the hart, and the scheduler charges it for the
+  // slice. if nothing is waiting, charge it here, so that it
+  // still moves down a level, and start its next slice.
+  preempt = 0;
+  if(tq[id].slice <= now){
+    if(c->nrunnable > 0){
+      tq[id].slice = NEVER;
+      preempt = 1;
+    } else if((len = chargeslice()) > 0){
+      tq[id].slice = now + len;
+    } else {
+      tq[id].slice = NEVER;
+    }
+  }
+  timerprogram();
+  return preempt;
+}
+
+// Append each hart's timer interrupt count to the statistics
+// report.
+int
+timerstats(char *buf, int sz)
+{
+  int i, n;
+
+  n = snprintf(buf, sz, "--- timer stats\n");
+  for(i = 0; i < NCPU && n < sz; i++){
+    if(tq[i].nintr > 0)
+      n += snprintf(buf + n, sz - n, "cpu %d: #timer interrupts %d\n", i, tq[i].nintr);
+  }
+  return n < sz ? n : sz - 1;
+}
@@ -6,20 +6,18 @@
 #include "proc.h"
 #include "defs.h"
 
-struct spinlock tickslock;
-uint ticks;
-
 extern char trampoline[], uservec[], userret[];
 
 // in kernelvec.S, calls kerneltrap().
 void kernelvec();
 
 extern int devintr();
+extern uint64 timer_scratch[NCPU][6];
 
 void
 trapinit(void)
 {
-  initlock(&tickslock, "time");
+  timersinit();
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -68,6 +66,10 @@ usertrap(void)
 
     // 这里相当于进行系统调用了
     syscall();
+  } else if((r_scause() == 12 || r_scause() == 13 || r_scause() == 15) &&
+            vmfault(p->pagetable, r_stval(), r_scause() == 15) != 0){
+    // instruction, load or store page fault on a page that is
+    // demand-paged or copy-on-write; the page is now mapped.
   } else if((which_dev = devintr()) != 0){
     // ok
   } else {
@@ -184,19 +186,11 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
-void
-clockintr()
-{
-  acquire(&tickslock);
-  ticks++;
-  wakeup(&ticks);
-  release(&tickslock);
-}
-
 // check if it's an external interrupt or software interrupt,
 // and handle it.
-// returns 2 if timer interrupt,
-// 1 if other device,
+// returns 2 if timer interrupt that ends the running process's
+// time slice, or an IPI asking it to give way,
+// 1 if other device, another hart, or another timer interrupt,
 // 0 if not recognized.
 int
 devintr()
@@ -227,17 +221,23 @@ devintr()
     return 1;
   } else if(scause == 0x8000000000000001L){
     // software interrupt from a machine-mode timer interrupt,
+    // or from another hart waking this one from wfi,
     // forwarded by timervec in kernelvec.S.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
-    // the SSIP bit in sip.
+    // the SSIP bit in sip. clear it before looking at the
+    // timer flag, so that a timer interrupt arriving in between
+    // raises it again rather than being lost.
     w_sip(r_sip() & ~2);
 
-    return 2;
+    if(__sync_lock_test_and_set(&timer_scratch[cpuid()][4], 0) == 0){
+      // an IPI: the scheduler will find the work it was sent
+      // for, at once if it is more urgent than what's running.
+      mycpu()->nipi++;
+      return needresched() ? 2 : 1;
+    }
+
+    return timerintr() ? 2 : 1;
   } else {
     return 0;
   }
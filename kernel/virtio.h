@@ -49,7 +49,7 @@
 // this many virtio descriptors.
 // must be a power of two.
 // virtio对应的描述符
-#define NUM 8
+#define NUM 128
 
 // a single descriptor, from the spec.
 // 单一的描述符
@@ -239,9 +239,13 @@ alloc3_desc(int *idx)
   return 0;
 }
 
-// 从磁盘中读写对应的块
+// Queue a read or write of b and return without waiting for it.
+// The caller must hold b's sleep-lock until the request is done:
+// either call virtio_disk_wait(), or set b->end_io, which
+// virtio_disk_intr() calls when the request completes.
+// Sleeps only if every descriptor is in use.
 void
-virtio_disk_rw(struct buf *b, int write)
+virtio_disk_submit(struct buf *b, int write)
 {
   // 获取数据块对应的sector号
   // 这里可以理解, 因为每个Sector的大小是512字节, 因此如果按照1024进行
@@ -320,21 +324,39 @@ virtio_disk_rw(struct buf *b, int write)
 
   *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
 
-  // Wait for virtio_disk_intr() to say request has finished.
+  release(&disk.vdisk_lock);
+}
+
+// Wait for a request started by virtio_disk_submit() to finish.
+void
+virtio_disk_wait(struct buf *b)
+{
+  acquire(&disk.vdisk_lock);
   // 检验直到磁盘操作结束
   while(b->disk == 1) {
     sleep(b, &disk.vdisk_lock);
   }
-
-  disk.info[idx[0]].b = 0;
-  free_chain(idx[0]);
-
   release(&disk.vdisk_lock);
 }
 
+// Read or write b and wait for it.
+void
+virtio_disk_rw(struct buf *b, int write)
+{
+  virtio_disk_submit(b, write);
+  virtio_disk_wait(b);
+}
+
+// Complete every request the device has finished: free its
+// descriptors, wake whoever is waiting on the buf, and call the
+// buf's end_io, if any, once the disk lock is released.
+// end_io runs in interrupt context and must not sleep.
 void
 virtio_disk_intr()
 {
+  struct buf *done[NUM/3];  // at most NUM/3 requests are in flight
+  int ndone = 0;
+
   acquire(&disk.vdisk_lock);
 
   // the device won't raise another interrupt until we tell it
@@ -358,11 +380,22 @@ virtio_disk_intr()
       panic("virtio_disk_intr status");
 
     struct buf *b = disk.info[id].b;
+    disk.info[id].b = 0;
+    free_chain(id);
     b->disk = 0;   // disk is done with buf
-    wakeup(b);
+    if(b->end_io)
+      done[ndone++] = b;
+    else
+      wakeup(b);
 
     disk.used_idx += 1;
   }
 
   release(&disk.vdisk_lock);
+
+  for(int i = 0; i < ndone; i++){
+    void (*end_io)(struct buf *) = done[i]->end_io;
+    done[i]->end_io = 0;
+    end_io(done[i]);
+  }
 }
@@ -0,0 +1,529 @@
+//
+// Per-process virtual memory areas: ranges of user address space
+// whose pages are filled in when first touched, rather than when
+// the mapping is set up.
+//
+// exec() records one area per ELF segment, and mmap() adds file
+// and anonymous regions between MMAPBASE and MMAPTOP. vmfault()
+// calls vmaload() for any fault that falls inside an area.
+//
+// File pages come from the page cache where they line up with
+// its pages, so a region shares them with read(), write() and
+// other processes mapping the file.
+//
+// Pages of a MAP_SHARED file region are mapped read-only at
+// first; the first write sets PTE_W and PTE_D, and pages with
+// PTE_D are written back to the file by munmap() and exit().
+//
+// Pages of a MAP_SHARED region that the file does not back, and
+// all pages of a shared anonymous region, live in a struct shm
+// that every copy of the region refers to, so fork() does not
+// have to touch them: a child faults them in like its parent.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "fs.h"
+#include "file.h"
+#include "pcache.h"
+#include "defs.h"
+
+// The pages of a shared region that are not file pages.
+// pages is indexed by user virtual address like a page table;
+// fork() keeps a region at the same address in the child, and
+// munmap() only ever takes pages out of it.
+struct shm {
+  int ref;             // areas that refer to it; 0 if free
+  pagetable_t pages;   // leaf PTEs point at the pages
+};
+
+struct {
+  struct spinlock lock;
+  struct shm shm[NSHM];
+} shmtable;
+
+void
+vmainit(void)
+{
+  initlock(&shmtable.lock, "shm");
+}
+
+// Allocate an empty shm with one reference, or return 0.
+static struct shm*
+shmalloc(void)
+{
+  struct shm *s;
+  pagetable_t pt;
+
+  if((pt = (pagetable_t)kalloc()) == 0)
+    return 0;
+  memset(pt, 0, PGSIZE);
+  acquire(&shmtable.lock);
+  for(s = shmtable.shm; s < shmtable.shm + NSHM; s++){
+    if(s->ref == 0){
+      s->ref = 1;
+      s->pages = pt;
+      release(&shmtable.lock);
+      return s;
+    }
+  }
+  release(&shmtable.lock);
+  kfree(pt);
+  return 0;
+}
+
+static void
+shmdup(struct shm *s)
+{
+  acquire(&shmtable.lock);
+  s->ref++;
+  release(&shmtable.lock);
+}
+
+// Free a page table level of an shm and the pages under it.
+static void
+shmfree(pagetable_t pt, int level)
+{
+  int i;
+
+  for(i = 0; i < 512; i++){
+    if((pt[i] & PTE_V) == 0)
+      continue;
+    if(level > 0)
+      shmfree((pagetable_t)PTE2PA(pt[i]), level - 1);
+    else
+      kfree((void*)PTE2PA(pt[i]));
+  }
+  kfree(pt);
+}
+
+// Drop a reference to s. The last one frees its pages; pages
+// that are still mapped somewhere keep their own references.
+static void
+shmput(struct shm *s)
+{
+  pagetable_t pt = 0;
+
+  acquire(&shmtable.lock);
+  if(--s->ref == 0){
+    pt = s->pages;
+    s->pages = 0;
+  }
+  release(&shmtable.lock);
+  if(pt)
+    shmfree(pt, 2);
+}
+
+// Return the page of s at va, allocating a zeroed one if there
+// is none yet, with a reference for the caller to map it.
+// Returns 0 if out of memory.
+static char*
+shmpage(struct shm *s, uint64 va)
+{
+  pte_t *pte;
+  char *mem = 0;
+
+  acquire(&shmtable.lock);
+  if((pte = walk(s->pages, va, 1)) == 0)
+    goto out;
+  if((*pte & PTE_V) == 0){
+    if((mem = kalloc()) == 0)
+      goto out;
+    memset(mem, 0, PGSIZE);
+    *pte = PA2PTE(mem) | PTE_V;
+  }
+  mem = (char*)PTE2PA(*pte);
+  krefinc(mem);
+ out:
+  release(&shmtable.lock);
+  return mem;
+}
+
+// Return the area in vma[] that covers va, or 0.
+struct vma*
+vmalookup(struct vma *vma, uint64 va)
+{
+  struct vma *v;
+
+  for(v = vma; v < vma + NVMA; v++){
+    if(v->end && va >= v->start && va < PGROUNDUP(v->end))
+      return v;
+  }
+  return 0;
+}
+
+// Back exec() area v by the program file ip. ip->nexec counts
+// such areas, so that the file can't change while vmaload() may
+// still read pages of it.
+void
+vmatext(struct vma *v, struct inode *ip)
+{
+  v->ip = idup(ip);
+  __sync_fetch_and_add(&ip->nexec, 1);
+}
+
+// Handle a fault at va inside area v: allocate the page, read
+// its contents from the inode, and map it into pagetable.
+// Bytes past the file-backed part of the area are zero; in a
+// shared area such pages come from its shm.
+// Pages of read-only areas come from the text cache, so that
+// every process running the same program shares them; other file
+// pages come from the page cache when they line up with its pages.
+// A write to a page that is already mapped is either the first
+// write to a shared page or a copy-on-write fault.
+// Returns the physical address of the page, or 0.
+uint64
+vmaload(pagetable_t pagetable, struct vma *v, uint64 va, int write)
+{
+  char *mem;
+  pte_t *pte;
+  uint64 off;
+  uint n;
+  int perm, locked;
+  struct pcpage *pg;
+
+  if(write && (v->perm & PTE_W) == 0)
+    return 0;
+  va = PGROUNDDOWN(va);
+
+  pte = walk(pagetable, va, 0);
+  if(pte && (*pte & PTE_V)){
+    if(!write || (*pte & PTE_U) == 0)
+      return 0;
+    if(v->flags & VMA_SHARED){
+      *pte |= PTE_W | PTE_D;
+      return PTE2PA(*pte);
+    }
+    return uvmcow(pagetable, va);
+  }
+
+  perm = PTE_U|v->perm;
+  if(v->flags & VMA_SHARED){
+    if(write)
+      perm |= PTE_D;
+    else
+      perm &= ~PTE_W;
+  }
+
+  off = va - v->start;
+  n = 0;
+  if(v->ip && off < v->filesz){
+    n = v->filesz - off;
+    if(n > PGSIZE)
+      n = PGSIZE;
+  }
+
+  if(n == 0 && v->shm){
+    if((mem = shmpage(v->shm, va)) == 0)
+      return 0;
+  } else if(n == 0){
+    if((mem = kalloc()) == 0)
+      return 0;
+    memset(mem, 0, PGSIZE);
+  } else {
+    // a fault taken from inside readi() or writei() on the
+    // same inode, e.g. a read() of the program's own file into
+    // its data segment, already holds the inode lock.
+    locked = holdingsleep(&v->ip->lock);
+    if(!locked)
+      ilock(v->ip);
+    if((v->perm & PTE_W) == 0){
+      mem = textget(v->ip, v->off + off, n);
+      perm |= PTE_TEXT;
+    } else if((v->off + off) % PGSIZE == 0 &&
+              (n == PGSIZE || (v->flags & VMA_SHARED) ||
+               v->off + off + n >= v->ip->size)){
+      // the page cache holds exactly this page: map it, so that
+      // the region and read()/write() see the same data. Shared
+      // regions always take this path, since their offset is
+      // page-aligned. Private regions get it copy-on-write.
+      mem = 0;
+      if((pg = pcacheget(v->ip, (v->off + off) / PGSIZE)) != 0){
+        if((v->flags & VMA_SHARED) || !write){
+          mem = pg->data;
+          krefinc(mem);
+          if((v->flags & VMA_SHARED) == 0)
+            perm = (perm & ~PTE_W) | PTE_COW;
+        } else if((mem = kalloc()) != 0){
+          memmove(mem, pg->data, PGSIZE);
+        }
+        pcacheput(pg);
+      }
+    } else if((mem = kalloc()) != 0){
+      memset(mem, 0, PGSIZE);
+      if(readi(v->ip, 0, (uint64)mem, v->off + off, n) != n){
+        kfree(mem);
+        mem = 0;
+      }
+    }
+    if(!locked)
+      iunlock(v->ip);
+    if(mem == 0)
+      return 0;
+  }
+
+  if(mappages(pagetable, va, PGSIZE, (uint64)mem, perm) != 0){
+    if(perm & PTE_TEXT)
+      textput(mem);
+    else
+      kfree(mem);
+    return 0;
+  }
+  return (uint64)mem;
+}
+
+// Write the dirty pages of a shared file area in [a, b)
+// back to the file.
+static void
+vmawriteback(pagetable_t pagetable, struct vma *v, uint64 a, uint64 b)
+{
+  int opmax = log_opmax();
+  int max = ((opmax-1-1-2) / 2) * BSIZE;
+  uint64 va, pa;
+  uint n, i, m;
+  pte_t *pte;
+  int r;
+
+  if((v->flags & VMA_SHARED) == 0 || v->ip == 0 || (v->perm & PTE_W) == 0)
+    return;
+  for(va = a; va < b; va += PGSIZE){
+    pte = walk(pagetable, va, 0);
+    if(pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_D) == 0)
+      continue;
+    if(va - v->start >= v->filesz)
+      break;
+    pa = PTE2PA(*pte);
+    n = v->filesz - (va - v->start);
+    if(n > PGSIZE)
+      n = PGSIZE;
+    // write a few blocks at a time to avoid exceeding
+    // the maximum log transaction size, as filewrite() does.
+    for(i = 0; i < n; i += m){
+      m = n - i;
+      if(m > max)
+        m = max;
+      begin_opn(opmax);
+      ilock(v->ip);
+      r = writei(v->ip, 0, pa + i, v->off + (va - v->start) + i, m);
+      iunlock(v->ip);
+      end_opn(opmax);
+      if(r != m)
+        break;
+    }
+  }
+}
+
+// Forget area v, dropping its inode and shm references.
+static void
+vmadrop(struct vma *v)
+{
+  if(v->shm)
+    shmput(v->shm);
+  if(v->ip){
+    if((v->flags & VMA_MMAP) == 0)
+      __sync_fetch_and_sub(&v->ip->nexec, 1);
+    begin_op();
+    iput(v->ip);
+    end_op();
+  }
+  memset(v, 0, sizeof(*v));
+}
+
+// Make a new mmap() region of len bytes in the current process,
+// backed by ip at off, or anonymous if ip is 0.
+// The region is placed below MMAPTOP, under any regions already
+// there. Returns its address, or -1.
+uint64
+vmamap(uint64 len, int perm, int flags, struct inode *ip, uint off)
+{
+  struct proc *p = myproc();
+  struct vma *v, *w;
+  uint64 a;
+  int i;
+
+  len = PGROUNDUP(len);
+  if(len == 0 || len > MMAPTOP - MMAPBASE)
+    return -1;
+  for(v = p->vma; v < p->vma + NVMA; v++)
+    if(v->end == 0)
+      break;
+  if(v == p->vma + NVMA)
+    return -1;
+
+  a = MMAPTOP - len;
+  for(i = 0; i < NVMA; i++){
+    w = &p->vma[i];
+    if(w->end && (w->flags & VMA_MMAP) && a < w->end && w->start < a + len){
+      if(w->start - MMAPBASE < len)
+        return -1;
+      a = w->start - len;
+      i = -1;  // start over
+    }
+  }
+
+  v->start = a;
+  v->end = a + len;
+  v->perm = perm;
+  v->flags = VMA_MMAP | flags;
+  v->off = off;
+  v->filesz = 0;
+  v->ip = 0;
+  v->shm = 0;
+  if((flags & VMA_SHARED) && (v->shm = shmalloc()) == 0){
+    v->end = 0;
+    return -1;
+  }
+  if(ip){
+    v->ip = idup(ip);
+    ilock(ip);
+    if(ip->size > off)
+      v->filesz = ip->size - off < len ? ip->size - off : len;
+    iunlock(ip);
+  }
+  return a;
+}
+
+// Remove the pages [addr, addr+len) of an mmap() region of the
+// current process, writing back shared pages that were modified.
+// The range may cover the whole region, either end of it, or a
+// hole in the middle, which splits the region in two.
+// Returns 0, or -1 if the range is not within one region.
+int
+vmaunmap(uint64 addr, uint64 len)
+{
+  struct proc *p = myproc();
+  struct vma *v, *w;
+  uint64 end, vend;
+
+  if(addr % PGSIZE || len == 0)
+    return -1;
+  end = PGROUNDUP(addr + len);
+  v = vmalookup(p->vma, addr);
+  if(v == 0 || (v->flags & VMA_MMAP) == 0)
+    return -1;
+  vend = PGROUNDUP(v->end);
+  if(end > vend)
+    return -1;
+
+  w = 0;
+  if(addr > v->start && end < vend){
+    for(w = p->vma; w < p->vma + NVMA; w++)
+      if(w->end == 0)
+        break;
+    if(w == p->vma + NVMA)
+      return -1;
+  }
+
+  vmawriteback(p->pagetable, v, addr, end);
+  uvmunmap(p->pagetable, addr, (end - addr) / PGSIZE, 1);
+
+  if(addr == v->start && end == vend){
+    vmadrop(v);
+    return 0;
+  }
+  if(w){
+    *w = *v;
+    if(w->ip)
+      idup(w->ip);
+    if(w->shm)
+      shmdup(w->shm);
+  } else if(addr == v->start){
+    w = v;
+  }
+  if(w){
+    // w becomes the part above the hole.
+    if(w->filesz > end - w->start)
+      w->filesz -= end - w->start;
+    else
+      w->filesz = 0;
+    w->off += end - w->start;
+    w->start = end;
+  }
+  if(addr > v->start){
+    // v becomes the part below the hole.
+    v->end = addr;
+    if(v->filesz > addr - v->start)
+      v->filesz = addr - v->start;
+  }
+  return 0;
+}
+
+// Give a child's page table the pages of the parent's mmap()
+// regions: shared regions map the same pages, private ones
+// become copy-on-write, as in uvmcopy(). Pages the parent has
+// not touched are left for the child to fault in.
+// Returns 0 on success, -1 on failure and frees any pages
+// already mapped into new.
+int
+vmacopy(pagetable_t old, pagetable_t new, struct vma *vma)
+{
+  struct vma *v;
+  uint64 a, pa;
+  pte_t *pte;
+
+  for(v = vma; v < vma + NVMA; v++){
+    if(v->end == 0 || (v->flags & VMA_MMAP) == 0)
+      continue;
+    for(a = v->start; a < PGROUNDUP(v->end); a += PGSIZE){
+      pte = walk(old, a, 0);
+      if(pte == 0 || (*pte & PTE_V) == 0)
+        continue;
+      if((v->flags & VMA_SHARED) == 0 && (*pte & PTE_W))
+        *pte = (*pte & ~PTE_W) | PTE_COW;
+      pa = PTE2PA(*pte);
+      if(mappages(new, a, PGSIZE, pa, PTE_FLAGS(*pte)) != 0)
+        goto err;
+      krefinc((void*)pa);
+    }
+  }
+  return 0;
+
+ err:
+  for(v = vma; v < vma + NVMA; v++){
+    if(v->end && (v->flags & VMA_MMAP))
+      uvmunmap(new, v->start, (PGROUNDUP(v->end) - v->start) / PGSIZE, 1);
+  }
+  return -1;
+}
+
+// Copy the areas of a parent into a child during fork().
+void
+vmadup(struct vma *dst, struct vma *src)
+{
+  int i;
+
+  for(i = 0; i < NVMA; i++){
+    dst[i] = src[i];
+    if(dst[i].ip)
+      idup(dst[i].ip);
+    if(dst[i].ip && (dst[i].flags & VMA_MMAP) == 0)
+      __sync_fetch_and_add(&dst[i].ip->nexec, 1);
+    if(dst[i].shm)
+      shmdup(dst[i].shm);
+  }
+}
+
+// Drop every area in vma[] and the inode references they hold.
+// If pagetable is not 0, first write back dirty shared pages
+// and unmap the areas' pages from it.
+// Must not be called inside a transaction.
+void
+vmaput(pagetable_t pagetable, struct vma *vma)
+{
+  struct vma *v;
+
+  for(v = vma; v < vma + NVMA; v++){
+    if(v->end == 0)
+      continue;
+    if(pagetable){
+      vmawriteback(pagetable, v, v->start, PGROUNDUP(v->end));
+      uvmunmap(pagetable, v->start, (PGROUNDUP(v->end) - v->start) / PGSIZE, 1);
+    }
+    vmadrop(v);
+  }
+}
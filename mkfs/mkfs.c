@@ -27,8 +27,8 @@
 int nbitmap = FSSIZE/(BSIZE*8) + 1;
 // 这里计算inode的块数: 总共需要inode个数 / 每个块中可以容纳inode的数目
 int ninodeblocks = NINODES / IPB + 1;
-// 日志块的数目
-int nlog = LOGSIZE;
+// 日志块的数目: the header block and LOGSIZE data blocks
+int nlog = LOGSIZE + 1;
 int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, bitmap), 总共元数据的数目
 int nblocks;  // Number of data blocks, 数据块的数目
 
@@ -46,6 +46,8 @@ void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
+void rootdir(void);
+void rootlink(struct dirent *de);
 void die(const char *);
 
 // convert to riscv byte order
@@ -77,10 +79,9 @@ int
 main(int argc, char *argv[])
 {
   int i, cc, fd;
-  uint rootino, inum, off;
+  uint rootino, inum;
   struct dirent de;
   char buf[BSIZE];
-  struct dinode din;
 
 
   static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
@@ -153,6 +154,10 @@ main(int argc, char *argv[])
   strcpy(de.name, "..");
   iappend(rootino, &de, sizeof(de));
 
+  // The root directory is hashed, with an index of depth 0
+  // in the rest of block 0 and its only leaf in block 1.
+  rootdir();
+
   // 添加用户内容
   for(i = 2; i < argc; i++){
     // get rid of "user/"
@@ -186,7 +191,7 @@ main(int argc, char *argv[])
     de.inum = xshort(inum);
     strncpy(de.name, shortname, DIRSIZ);
     // 添加到对应的目录中
-    iappend(rootino, &de, sizeof(de));
+    rootlink(&de);
 
     // 追加buff
     while((cc = read(fd, buf, sizeof(buf))) > 0)
@@ -195,13 +200,6 @@ main(int argc, char *argv[])
     close(fd);
   }
 
-  // fix size of root inode dir
-  rinode(rootino, &din);
-  off = xint(din.size);
-  off = ((off/BSIZE) + 1) * BSIZE;
-  din.size = xint(off);
-  winode(rootino, &din);
-
   // 更新balloc, 写入磁盘中的superblock
   balloc(freeblock);
 
@@ -299,6 +297,100 @@ balloc(int used)
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+// Return the disk block holding block fbn of the file din.
+// Files grow one block at a time from freeblock, so a new block
+// usually extends the file's last extent.
+uint
+iblock(struct dinode *din, uint fbn)
+{
+  struct extent xext[NXEXTENT];
+  struct extent *e, *last;
+  uint len, bn, x;
+  int i;
+
+  if(xint(din->xblock))
+    rsect(xint(din->xblock), (char*)xext);
+
+  // look for fbn in the existing extents.
+  last = 0;
+  bn = fbn;
+  for(i = 0; i < NEXTENT + NXEXTENT; i++){
+    e = i < NEXTENT ? &din->ext[i] : &xext[i - NEXTENT];
+    if(i == NEXTENT && xint(din->xblock) == 0)
+      break;
+    if((len = xint(e->len)) == 0)
+      break;
+    if(bn < len)
+      return xint(e->start) + bn;
+    bn -= len;
+    last = e;
+  }
+  assert(bn == 0);  // no holes
+
+  // append a block.
+  x = freeblock++;
+  if(last && xint(last->start) + xint(last->len) == x){
+    last->len = xint(xint(last->len) + 1);
+  } else {
+    if(i == NEXTENT && xint(din->xblock) == 0){
+      din->xblock = xint(x);
+      memset(xext, 0, sizeof(xext));
+      x = freeblock++;
+    }
+    assert(i < NEXTENT + NXEXTENT);
+    e = i < NEXTENT ? &din->ext[i] : &xext[i - NEXTENT];
+    e->start = xint(x);
+    e->len = xint(1);
+  }
+  if(xint(din->xblock))
+    wsect(xint(din->xblock), (char*)xext);
+  return x;
+}
+
+// Lay out the hashed root directory after "." and "..".
+void
+rootdir(void)
+{
+  struct dirhead h;
+  struct diridx x;
+
+  bzero(&h, sizeof(h));
+  h.magic = xshort(DIRHASH);
+  h.depth = xshort(0);
+  iappend(ROOTINO, &h, sizeof(h));
+  bzero(&x, sizeof(x));
+  x.leaf[0] = xshort(1);
+  iappend(ROOTINO, &x, sizeof(x));
+  iappend(ROOTINO, zeroes, BSIZE - 4*sizeof(struct dirent));
+
+  bzero(&h, sizeof(h));
+  h.magic = xshort(DIRLEAF);
+  h.depth = xshort(0);
+  iappend(ROOTINO, &h, sizeof(h));
+  iappend(ROOTINO, zeroes, BSIZE - sizeof(h));
+}
+
+// Add de to the root directory's leaf.
+void
+rootlink(struct dirent *de)
+{
+  struct dinode din;
+  struct dirent leaf[DPB];
+  uint b;
+  int i;
+
+  rinode(ROOTINO, &din);
+  b = iblock(&din, 1);
+  rsect(b, leaf);
+  for(i = 1; i < DPB; i++){
+    if(leaf[i].inum == 0)
+      break;
+  }
+  assert(i < DPB);  // too many files for one leaf
+  leaf[i] = *de;
+  wsect(b, leaf);
+}
+
 // inum对应的是inode号
 // xp对应的是指针, 例如&dirent, n表示写入的大小
 void
@@ -308,7 +400,6 @@ iappend(uint inum, void *xp, int n)
   uint fbn, off, n1;
   struct dinode din;
   char buf[BSIZE];
-  uint indirect[NINDIRECT]; // 二级表
   uint x;
 
   // 从磁盘读取对应的inum对应的inode
@@ -319,31 +410,7 @@ iappend(uint inum, void *xp, int n)
     // fb中的偏置
     fbn = off / BSIZE;
     assert(fbn < MAXFILE);
-    // 如果存储内容在直接块中
-    if(fbn < NDIRECT){
-      // 如果当前没有数据块
-      if(xint(din.addrs[fbn]) == 0){
-        // 分配新的数据块号
-        din.addrs[fbn] = xint(freeblock++);
-      }
-      // 获取对应的磁盘区块号
-      x = xint(din.addrs[fbn]);
-    } else {
-      // 说明新的数据要存储在非直接块中
-      if(xint(din.addrs[NDIRECT]) == 0){
-        // 首先分配一个非直接磁盘块
-        din.addrs[NDIRECT] = xint(freeblock++);
-      }
-      // 读取对应的sector
-      rsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      // 如果对应的地址也是0, 那么也需要进行分配
-      if(indirect[fbn - NDIRECT] == 0){
-        indirect[fbn - NDIRECT] = xint(freeblock++);
-        // 写入磁盘块
-        wsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      }
-      x = xint(indirect[fbn-NDIRECT]);
-    }
+    x = iblock(&din, fbn);
 
     n1 = min(n, (fbn + 1) * BSIZE - off);
     // 读取对应的磁盘块
@@ -0,0 +1,133 @@
+// Measure block allocation on a nearly full disk.
+//
+// allocbench fills the disk with files of assorted sizes, then
+// deletes every third one, leaving the free space in holes
+// between files. It then writes new files into the holes and
+// reports how long that took and how many extents (runs of
+// consecutive blocks) each new file ended up in.
+//
+//   allocbench [kbytes]
+//
+// kbytes is the size of each new file (default 64).
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define NFILL 150     // files used to fill the disk
+#define NNEW  100     // most new files to write into the holes
+
+char buf[8192];
+uint seed = 1;
+
+int
+rand(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) & 0x7fff;
+}
+
+void
+name(char *p, char c, int i)
+{
+  p[0] = 'a';
+  p[1] = 'b';
+  p[2] = c;
+  p[3] = '0' + i / 100;
+  p[4] = '0' + i / 10 % 10;
+  p[5] = '0' + i % 10;
+  p[6] = 0;
+}
+
+// Write a file of up to kbytes; returns the KB written.
+int
+writefile(char *path, int kbytes)
+{
+  int fd, i, n, m;
+
+  fd = open(path, O_CREATE|O_TRUNC|O_WRONLY);
+  if(fd < 0)
+    return -1;
+  for(i = 0; i < kbytes; i += m / 1024){
+    n = kbytes - i < sizeof(buf) / 1024 ? (kbytes - i) * 1024 : sizeof(buf);
+    if((m = write(fd, buf, n)) < 1024)
+      break;
+  }
+  close(fd);
+  return i;
+}
+
+int
+main(int argc, char *argv[])
+{
+  char path[8];
+  int kbytes, i, n, nnew, next, t0, t, tot;
+  struct stat st;
+
+  kbytes = 64;
+  if(argc > 1)
+    kbytes = atoi(argv[1]);
+  if(kbytes <= 0){
+    printf("usage: allocbench [kbytes]\n");
+    exit(1);
+  }
+
+  // fill the disk.
+  printf("allocbench: filling disk\n");
+  tot = 0;
+  for(i = 0; i < NFILL; i++){
+    name(path, 'f', i);
+    if((n = writefile(path, 32 + rand() % 160)) < 0)
+      break;
+    tot += n;
+  }
+  name(path, 'f', i);
+  if((n = writefile(path, 100000)) > 0)
+    tot += n;
+  n = i + 1;
+
+  // punch holes.
+  for(i = 0; i < n; i += 3){
+    name(path, 'f', i);
+    unlink(path);
+  }
+  printf("allocbench: %d KB in %d files, deleted every third\n", tot, n);
+
+  // write into the holes.
+  tot = 0;
+  next = 0;
+  t0 = uptime();
+  for(nnew = 0; nnew < NNEW; nnew++){
+    name(path, 'n', nnew);
+    if((i = writefile(path, kbytes)) <= 0){
+      unlink(path);
+      break;
+    }
+    tot += i;
+    if(stat(path, &st) == 0)
+      next += st.nextent;
+    if(i < kbytes){
+      nnew++;
+      break;
+    }
+  }
+  t = uptime() - t0;
+  if(t == 0)
+    t = 1;
+  printf("allocbench: wrote %d KB in %d files in %d ticks, %d KB/tick\n",
+         tot, nnew, t, tot / t);
+  if(nnew > 0)
+    printf("allocbench: %d extents, %d.%d per file\n",
+           next, next / nnew, next * 10 / nnew % 10);
+
+  for(i = 0; i < nnew; i++){
+    name(path, 'n', i);
+    unlink(path);
+  }
+  for(i = 0; i < n; i++){
+    name(path, 'f', i);
+    unlink(path);
+  }
+  exit(0);
+}
@@ -0,0 +1,163 @@
+// Stress the buffer cache from several processes at once and
+// report spinlock contention from the statistics device.
+//
+// Each child owns a directory of NFILE small files and keeps
+// opening them and reading a byte. There are more files in all
+// than the kernel's inode table holds, so most opens have to
+// read the inode, and then the file's first block, back through
+// the buffer cache.
+//
+//   bcachetest [nchild]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define NFILE   20
+#define ROUNDS  50
+
+char statbuf[4096];
+
+// Read the whole statistics report into statbuf.
+// Returns the total number of spins on contended locks.
+int
+statistics(void)
+{
+  int fd, n, i;
+  char *p;
+
+  fd = open("statistics", O_RDONLY);
+  if(fd < 0){
+    printf("bcachetest: cannot open statistics\n");
+    exit(1);
+  }
+  n = 0;
+  while(n < sizeof(statbuf) - 1 && (i = read(fd, statbuf + n, sizeof(statbuf) - 1 - n)) > 0)
+    n += i;
+  close(fd);
+  statbuf[n] = 0;
+
+  for(p = statbuf; *p; p++)
+    if(memcmp(p, "tot= ", 5) == 0)
+      return atoi(p + 5);
+  return 0;
+}
+
+void
+mkname(char *buf, int child, int i)
+{
+  buf[0] = 'b';
+  buf[1] = 'c';
+  buf[2] = '0' + child / 10;
+  buf[3] = '0' + child % 10;
+  buf[4] = '/';
+  buf[5] = 'f';
+  buf[6] = '0' + i / 10;
+  buf[7] = '0' + i % 10;
+  buf[8] = 0;
+}
+
+void
+setup(int child)
+{
+  char name[16];
+  int i, fd;
+
+  mkname(name, child, 0);
+  name[4] = 0;
+  mkdir(name);
+  for(i = 0; i < NFILE; i++){
+    mkname(name, child, i);
+    fd = open(name, O_CREATE|O_RDWR);
+    if(fd < 0 || write(fd, name, sizeof(name)) != sizeof(name)){
+      printf("bcachetest: cannot create %s\n", name);
+      exit(1);
+    }
+    close(fd);
+  }
+}
+
+void
+worker(int child)
+{
+  char name[16], c;
+  int r, i, fd;
+
+  for(r = 0; r < ROUNDS; r++){
+    for(i = 0; i < NFILE; i++){
+      mkname(name, child, i);
+      fd = open(name, O_RDONLY);
+      if(fd < 0 || read(fd, &c, 1) != 1 || c != 'b'){
+        printf("bcachetest: cannot read %s\n", name);
+        exit(1);
+      }
+      close(fd);
+    }
+  }
+  exit(0);
+}
+
+void
+cleanup(int child)
+{
+  char name[16];
+  int i;
+
+  for(i = 0; i < NFILE; i++){
+    mkname(name, child, i);
+    unlink(name);
+  }
+  name[4] = 0;
+  unlink(name);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nchild, i, st, t0, t1, tot0, tot1, ok;
+
+  nchild = 4;
+  if(argc > 1)
+    nchild = atoi(argv[1]);
+  if(nchild < 1 || nchild > 99){
+    printf("usage: bcachetest [nchild]\n");
+    exit(1);
+  }
+
+  for(i = 0; i < nchild; i++)
+    setup(i);
+
+  tot0 = statistics();
+  t0 = uptime();
+  for(i = 0; i < nchild; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("bcachetest: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      worker(i);
+  }
+  ok = 1;
+  for(i = 0; i < nchild; i++){
+    wait(&st);
+    if(st != 0)
+      ok = 0;
+  }
+  t1 = uptime();
+  tot1 = statistics();
+
+  printf("%s", statbuf);
+  printf("bcachetest: %d processes, %d opens each, %d ticks, %d spins on contended locks\n",
+         nchild, ROUNDS * NFILE, t1 - t0, tot1 - tot0);
+
+  for(i = 0; i < nchild; i++)
+    cleanup(i);
+  if(!ok){
+    printf("bcachetest: FAILED\n");
+    exit(1);
+  }
+  printf("bcachetest: OK\n");
+  exit(0);
+}
@@ -0,0 +1,100 @@
+// Measure operations on a large directory.
+//
+// dirbench makes a fresh directory and times adding n names to
+// it, looking each one up, and removing them again. The names
+// are links to a single file, so the benchmark needs only one
+// inode however large n is.
+//
+//   dirbench [n]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define DIR "dirbench.d"
+
+char path[32];
+
+char*
+name(int i)
+{
+  strcpy(path, DIR "/e");
+  path[sizeof(DIR) + 1] = '0' + i / 10000 % 10;
+  path[sizeof(DIR) + 2] = '0' + i / 1000 % 10;
+  path[sizeof(DIR) + 3] = '0' + i / 100 % 10;
+  path[sizeof(DIR) + 4] = '0' + i / 10 % 10;
+  path[sizeof(DIR) + 5] = '0' + i % 10;
+  path[sizeof(DIR) + 6] = 0;
+  return path;
+}
+
+void
+report(char *what, int n, int t)
+{
+  printf("dirbench: %s %d names in %d ticks", what, n, t);
+  if(t > 0)
+    printf(", %d per tick", n / t);
+  printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, i, fd, t0;
+  struct stat st;
+
+  n = 10000;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n <= 0 || n > 30000){
+    printf("usage: dirbench [n]\n");
+    exit(1);
+  }
+
+  if(mkdir(DIR) < 0){
+    printf("dirbench: cannot make %s\n", DIR);
+    exit(1);
+  }
+  fd = open(DIR "/f", O_CREATE|O_WRONLY);
+  if(fd < 0){
+    printf("dirbench: cannot create %s/f\n", DIR);
+    exit(1);
+  }
+  close(fd);
+
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    if(link(DIR "/f", name(i)) < 0){
+      printf("dirbench: link %s failed\n", name(i));
+      n = i;
+      break;
+    }
+  }
+  report("create", n, uptime() - t0);
+
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    if(stat(name(i), &st) < 0){
+      printf("dirbench: stat %s failed\n", name(i));
+      exit(1);
+    }
+  }
+  report("lookup", n, uptime() - t0);
+
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    if(unlink(name(i)) < 0){
+      printf("dirbench: unlink %s failed\n", name(i));
+      exit(1);
+    }
+  }
+  report("unlink", n, uptime() - t0);
+
+  unlink(DIR "/f");
+  if(unlink(DIR) < 0){
+    printf("dirbench: cannot remove %s\n", DIR);
+    exit(1);
+  }
+  exit(0);
+}
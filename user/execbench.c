@@ -0,0 +1,72 @@
+// Measure exec() latency for a program with a large image.
+//
+// execbench carries BIGSZ bytes of initialized data, so an exec
+// that reads the whole image from disk up front pays for all of
+// it. It times NEXEC fork+exec+exit rounds of itself twice: once
+// where the new image exits straight away, and once where it
+// touches every page of the array first. With demand-paged exec
+// only the second run pays for reading the array.
+//
+//   execbench [nexec]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+#define BIGSZ (160*1024)
+
+char big[BIGSZ] = { 1 };
+
+int
+run(char *prog, char *mode, int n)
+{
+  char *argv[] = { prog, mode, 0 };
+  int i, t0, pid, st;
+
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("execbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(prog, argv);
+      printf("execbench: exec %s failed\n", prog);
+      exit(1);
+    }
+    wait(&st);
+    if(st != 0){
+      printf("execbench: child failed\n");
+      exit(1);
+    }
+  }
+  return uptime() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, sum, t;
+
+  if(argc > 1 && strcmp(argv[1], "-exit") == 0)
+    exit(0);
+  if(argc > 1 && strcmp(argv[1], "-touch") == 0){
+    sum = 0;
+    for(i = 0; i < BIGSZ; i += PGSIZE)
+      sum += big[i];
+    exit(sum == 1 ? 0 : 1);
+  }
+
+  n = 100;
+  if(argc > 1)
+    n = atoi(argv[1]);
+
+  printf("execbench: %d execs of a %d KB image\n", n, BIGSZ / 1024);
+  t = run(argv[0], "-exit", n);
+  printf("exec and exit: %d ticks\n", t);
+  t = run(argv[0], "-touch", n);
+  printf("exec and touch all data: %d ticks\n", t);
+  exit(0);
+}
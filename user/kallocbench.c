@@ -0,0 +1,87 @@
+// Measure how page allocation throughput scales with the number
+// of processes hammering the kernel allocator at once.
+//
+// Each worker repeatedly grows its heap by NPAGE pages, touches
+// every page (so that the kernel really has to hand one out),
+// and shrinks the heap again. Run under "make CPUS=8 qemu" to see
+// scaling across 1..8 harts.
+//
+//   kallocbench [maxprocs]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+#define NPAGE  64
+#define ROUNDS 200
+
+void
+worker(void)
+{
+  char *p;
+  int r, i;
+
+  for(r = 0; r < ROUNDS; r++){
+    p = sbrk(NPAGE*PGSIZE);
+    if(p == (char*)-1){
+      printf("kallocbench: sbrk failed\n");
+      exit(1);
+    }
+    for(i = 0; i < NPAGE; i++)
+      p[i*PGSIZE] = r;
+    sbrk(-(NPAGE*PGSIZE));
+  }
+  exit(0);
+}
+
+int
+run(int nproc)
+{
+  int i, t0, t1, st, ok;
+
+  t0 = uptime();
+  for(i = 0; i < nproc; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("kallocbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      worker();
+  }
+  ok = 1;
+  for(i = 0; i < nproc; i++){
+    wait(&st);
+    if(st != 0)
+      ok = 0;
+  }
+  t1 = uptime();
+  if(!ok)
+    return -1;
+  return t1 - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, maxprocs, t, pages;
+
+  maxprocs = 8;
+  if(argc > 1)
+    maxprocs = atoi(argv[1]);
+
+  printf("kallocbench: %d rounds of %d pages per process\n", ROUNDS, NPAGE);
+  for(n = 1; n <= maxprocs; n++){
+    t = run(n);
+    if(t < 0){
+      printf("kallocbench: worker failed\n");
+      exit(1);
+    }
+    if(t == 0)
+      t = 1;
+    pages = n * ROUNDS * NPAGE;
+    printf("procs %d: %d pages in %d ticks, %d pages/tick\n", n, pages, t, pages / t);
+  }
+  exit(0);
+}
@@ -0,0 +1,93 @@
+// Measure how quickly an interactive process gets the CPU.
+//
+// latbench plays an interactive process: it sleeps for a short
+// time with nanosleep(), does a little work, and sleeps again,
+// measuring how late each wakeup is, that is, how long it waited
+// for a CPU after its sleep ended. It does this first alone and
+// then with nspin processes (default 8) that only compute, which
+// a scheduler that favours processes that sleep should hardly
+// notice. With a nice value, the spinners also lower their own
+// priority with nice().
+//
+//   latbench [nspin [nice]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define ROUNDS  200
+#define SLEEPNS 2000000ULL   // 2 ms
+#define WARMUP  5            // ticks for the spinners to settle
+
+void
+measure(int nspin, int n)
+{
+  uint64 t0, t1, late, tot, max;
+  volatile int x;
+  int i;
+
+  tot = max = 0;
+  for(i = 0; i < ROUNDS; i++){
+    clock_gettime(&t0);
+    if(nanosleep(SLEEPNS) < 0){
+      printf("latbench: nanosleep failed\n");
+      exit(1);
+    }
+    clock_gettime(&t1);
+    late = t1 - t0 - SLEEPNS;
+    tot += late;
+    if(late > max)
+      max = late;
+    for(x = 0; x < 1000; x++)
+      ;
+  }
+  printf("latbench: %d spinners", nspin);
+  if(nspin > 0)
+    printf(" (nice %d)", n);
+  printf(": wakeup late by %d us on average, %d us at most\n",
+         (int)(tot / ROUNDS / 1000), (int)(max / 1000));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nspin, n, i, pids[32];
+  volatile int x;
+
+  nspin = 8;
+  n = 0;
+  if(argc > 1)
+    nspin = atoi(argv[1]);
+  if(argc > 2)
+    n = atoi(argv[2]);
+  if(nspin < 0 || nspin > 32){
+    printf("usage: latbench [nspin [nice]]\n");
+    exit(1);
+  }
+
+  measure(0, 0);
+
+  for(i = 0; i < nspin; i++){
+    if((pids[i] = fork()) < 0){
+      printf("latbench: fork failed\n");
+      nspin = i;
+      break;
+    }
+    if(pids[i] == 0){
+      if(n != 0 && nice(0, n) < 0){
+        printf("latbench: nice %d failed\n", n);
+        exit(1);
+      }
+      for(x = 0; ; x++)
+        ;
+    }
+  }
+  sleep(WARMUP);
+  measure(nspin, n);
+
+  for(i = 0; i < nspin; i++){
+    kill(pids[i]);
+    wait(0);
+  }
+  exit(0);
+}
@@ -0,0 +1,85 @@
+// Measure path name lookup.
+//
+// namebench makes a directory tree a few levels deep and times
+// n stat()s of a file at the bottom, n of a name that doesn't
+// exist, and n opens of a program in / the way sh runs one.
+//
+//   namebench [n]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define DEEP "nb/a/b/c/d/f"
+
+void
+report(char *what, int n, int t)
+{
+  printf("namebench: %d %s in %d ticks", n, what, t);
+  if(t > 0)
+    printf(", %d per tick", n / t);
+  printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, i, fd, t0;
+  struct stat st;
+
+  n = 10000;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n <= 0){
+    printf("usage: namebench [n]\n");
+    exit(1);
+  }
+
+  if(mkdir("nb") < 0 || mkdir("nb/a") < 0 || mkdir("nb/a/b") < 0 ||
+     mkdir("nb/a/b/c") < 0 || mkdir("nb/a/b/c/d") < 0){
+    printf("namebench: cannot make nb/a/b/c/d\n");
+    exit(1);
+  }
+  if((fd = open(DEEP, O_CREATE|O_WRONLY)) < 0){
+    printf("namebench: cannot create %s\n", DEEP);
+    exit(1);
+  }
+  close(fd);
+
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    if(stat(DEEP, &st) < 0){
+      printf("namebench: stat %s failed\n", DEEP);
+      exit(1);
+    }
+  }
+  report("stats of " DEEP, n, uptime() - t0);
+
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    if(stat("nb/a/b/c/d/nope", &st) == 0){
+      printf("namebench: nb/a/b/c/d/nope exists\n");
+      exit(1);
+    }
+  }
+  report("stats of a missing name", n, uptime() - t0);
+
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    if((fd = open("/echo", O_RDONLY)) < 0){
+      printf("namebench: open /echo failed\n");
+      exit(1);
+    }
+    close(fd);
+  }
+  report("opens of /echo", n, uptime() - t0);
+
+  unlink(DEEP);
+  unlink("nb/a/b/c/d");
+  unlink("nb/a/b/c");
+  unlink("nb/a/b");
+  unlink("nb/a");
+  unlink("nb");
+  exit(0);
+}
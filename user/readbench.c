@@ -0,0 +1,94 @@
+// Measure streaming read throughput.
+//
+// readbench writes a file of the given size, then reads it
+// front to back twice with read()s of bufsize bytes. The first
+// pass finds the file's data on disk, so it shows how well
+// readahead keeps the disk busy; the second finds it in the
+// page cache.
+//
+//   readbench [kbytes [bufsize]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define FNAME "readbench.tmp"
+
+char buf[8192];
+
+// Print n bytes in t ticks (of about 1/10 second) as MB/s.
+void
+report(char *what, int n, int t)
+{
+  int kbs;
+
+  if(t == 0)
+    t = 1;
+  kbs = n / 1024 * 10 / t;
+  printf("readbench: %s: %d KB in %d ticks, %d.%d MB/s\n",
+         what, n / 1024, t, kbs / 1024, kbs % 1024 * 10 / 1024);
+}
+
+int
+readall(int bufsize)
+{
+  int fd, n, tot;
+
+  fd = open(FNAME, O_RDONLY);
+  if(fd < 0){
+    printf("readbench: cannot open %s\n", FNAME);
+    exit(1);
+  }
+  tot = 0;
+  while((n = read(fd, buf, bufsize)) > 0)
+    tot += n;
+  close(fd);
+  return tot;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int kbytes, bufsize, fd, i, n, tot, t0;
+
+  kbytes = 256;
+  bufsize = 4096;
+  if(argc > 1)
+    kbytes = atoi(argv[1]);
+  if(argc > 2)
+    bufsize = atoi(argv[2]);
+  if(kbytes <= 0 || bufsize <= 0 || bufsize > sizeof(buf)){
+    printf("usage: readbench [kbytes [bufsize]]\n");
+    exit(1);
+  }
+
+  fd = open(FNAME, O_CREATE|O_TRUNC|O_WRONLY);
+  if(fd < 0){
+    printf("readbench: cannot create %s\n", FNAME);
+    exit(1);
+  }
+  for(i = 0; i < sizeof(buf); i++)
+    buf[i] = i;
+  tot = 0;
+  for(i = 0; i < kbytes; i += n / 1024){
+    n = kbytes - i < sizeof(buf) / 1024 ? (kbytes - i) * 1024 : sizeof(buf);
+    if((n = write(fd, buf, n)) <= 0)
+      break;
+    tot += n;
+  }
+  close(fd);
+  if(tot < kbytes * 1024)
+    printf("readbench: file is only %d KB\n", tot / 1024);
+
+  t0 = uptime();
+  n = readall(bufsize);
+  report("cold", n, uptime() - t0);
+
+  t0 = uptime();
+  n = readall(bufsize);
+  report("cached", n, uptime() - t0);
+
+  unlink(FNAME);
+  exit(n == tot ? 0 : 1);
+}
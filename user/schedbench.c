@@ -0,0 +1,101 @@
+// Measure the scheduler.
+//
+// For n = 1, 2, 4, up to maxn (default 8), schedbench runs
+//  - n pairs of processes passing a byte back and forth through
+//    two pipes, which measures how fast the kernel can switch
+//    between processes with n harts' worth of pairs, and
+//  - one such pair alongside n processes that only compute,
+//    which measures how long a woken process waits for a hart
+//    while the harts are busy.
+// Run it with different numbers of harts (make CPUS=...) to
+// compare them.
+//
+//   schedbench [maxn]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define ROUNDS 2000
+
+// Bounce a byte between two processes ROUNDS times, then exit.
+void
+pingpong(void)
+{
+  int a[2], b[2], i;
+  char c;
+
+  if(pipe(a) < 0 || pipe(b) < 0){
+    printf("schedbench: pipe failed\n");
+    exit(1);
+  }
+  if(fork() == 0){
+    for(i = 0; i < ROUNDS; i++){
+      if(read(a[0], &c, 1) != 1)
+        exit(1);
+      write(b[1], &c, 1);
+    }
+    exit(0);
+  }
+  for(i = 0; i < ROUNDS; i++){
+    write(a[1], &c, 1);
+    if(read(b[0], &c, 1) != 1)
+      exit(1);
+  }
+  wait(0);
+  exit(0);
+}
+
+void
+report(char *what, int n, int rounds, int t)
+{
+  printf("schedbench: %s %d: %d round trips in %d ticks", what, n, rounds, t);
+  if(t > 0)
+    printf(", %d per tick", rounds / t);
+  printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int maxn, n, i, t0, pids[8];
+  volatile int x;
+
+  maxn = 8;
+  if(argc > 1)
+    maxn = atoi(argv[1]);
+  if(maxn < 1 || maxn > 8){
+    printf("usage: schedbench [maxn]\n");
+    exit(1);
+  }
+
+  for(n = 1; n <= maxn; n *= 2){
+    t0 = uptime();
+    for(i = 0; i < n; i++){
+      if(fork() == 0)
+        pingpong();
+    }
+    for(i = 0; i < n; i++)
+      wait(0);
+    report("pairs", n, n * ROUNDS, uptime() - t0);
+  }
+
+  for(n = 1; n <= maxn; n *= 2){
+    for(i = 0; i < n; i++){
+      if((pids[i] = fork()) == 0){
+        for(x = 0; ; x++)
+          ;
+      }
+    }
+    t0 = uptime();
+    if(fork() == 0)
+      pingpong();
+    wait(0);
+    report("pair with spinners", n, ROUNDS, uptime() - t0);
+    for(i = 0; i < n; i++){
+      kill(pids[i]);
+      wait(0);
+    }
+  }
+  exit(0);
+}
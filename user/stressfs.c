@@ -6,6 +6,9 @@
 // after about 5 runs of stressfs in QEMU on a 2.1GHz CPU:
 //    for (i = 0; i < 40000; i++)
 //      asm volatile("");
+//
+// stressfs [nchild] runs nchild+1 processes instead of 5, and
+// reports how long they took, to measure concurrent writes.
 
 #include "kernel/types.h"
 #include "kernel/stat.h"
@@ -16,16 +19,26 @@
 int
 main(int argc, char *argv[])
 {
-  int fd, i;
+  int fd, i, me, n, t0;
   char path[] = "stressfs0";
   char data[512];
 
+  n = 4;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n < 0 || n > 40){
+    printf("usage: stressfs [nchild]\n");
+    exit(1);
+  }
+
   printf("stressfs starting\n");
   memset(data, 'a', sizeof(data));
+  t0 = uptime();
 
-  for(i = 0; i < 4; i++)
+  for(i = 0; i < n; i++)
     if(fork() > 0)
       break;
+  me = i;
 
   printf("write %d\n", i);
 
@@ -45,5 +58,7 @@ main(int argc, char *argv[])
 
   wait(0);
 
+  if(me == 0)
+    printf("stressfs: %d processes took %d ticks\n", n + 1, uptime() - t0);
   exit(0);
 }
@@ -1,6 +1,8 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
 #include "user/user.h"
 
 //
@@ -145,3 +147,39 @@ memcpy(void *dst, const void *src, uint n)
 {
   return memmove(dst, src, n);
 }
+
+// The kernel keeps the process's pid, its hart, and the clock's
+// rate in the read-only USYSCALL page, so these need no system
+// call. sysgetpid(), sysuptime() and sysclock_gettime() are the
+// system calls themselves.
+
+int
+getpid(void)
+{
+  return ((struct usyscall*)USYSCALL)->pid;
+}
+
+// The hart the process was last scheduled on; it may have moved
+// by the time the caller looks at the answer.
+int
+getcpu(void)
+{
+  return ((struct usyscall*)USYSCALL)->cpu;
+}
+
+int
+uptime(void)
+{
+  return r_time() / ((struct usyscall*)USYSCALL)->tickcycles;
+}
+
+int
+clock_gettime(uint64 *ns)
+{
+  uint64 t, hz;
+
+  t = r_time();
+  hz = ((struct usyscall*)USYSCALL)->mtimehz;
+  *ns = t / hz * 1000000000ULL + t % hz * 1000000000ULL / hz;
+  return 0;
+}
@@ -18,10 +18,15 @@ int link(const char*, const char*);
 int mkdir(const char*);
 int chdir(const char*);
 int dup(int);
-int getpid(void);
 char* sbrk(int);
 int sleep(int);
-int uptime(void);
+void* mmap(void*, int, int, int, int, int);
+int munmap(void*, int);
+int nanosleep(uint64);
+int nice(int, int);
+int sysgetpid(void);
+int sysuptime(void);
+int sysclock_gettime(uint64*);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -39,3 +44,7 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+int getpid(void);
+int getcpu(void);
+int uptime(void);
+int clock_gettime(uint64*);
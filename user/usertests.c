@@ -2556,6 +2556,820 @@ sbrk8000(char *s)
 
 
 
+// fork a process that uses more than half of physical memory.
+// this only works if fork() shares the pages copy-on-write
+// instead of copying them.
+void
+cowbig(char *s)
+{
+  uint64 sz = (PHYSTOP - KERNBASE) / 3 * 2;
+  char *a, *p;
+  int pid, xstatus;
+
+  a = sbrk(sz);
+  if(a == (char*)0xffffffffffffffffL){
+    printf("%s: sbrk(%l) failed\n", s, sz);
+    exit(1);
+  }
+  for(p = a; p < a + sz; p += PGSIZE)
+    *(int*)p = getpid();
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    int ppid = *(int*)a;
+    for(p = a; p < a + sz; p += PGSIZE){
+      if(*(int*)p != ppid){
+        printf("%s: child sees %d, not %d\n", s, *(int*)p, ppid);
+        exit(1);
+      }
+    }
+    // each of these writes copies a page.
+    for(p = a; p < a + sz/8; p += PGSIZE)
+      *(int*)p = getpid();
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(xstatus);
+
+  for(p = a; p < a + sz; p += PGSIZE){
+    if(*(int*)p != getpid()){
+      printf("%s: child's write reached the parent\n", s);
+      exit(1);
+    }
+  }
+  if(sbrk(-sz) == (char*)0xffffffffffffffffL){
+    printf("%s: sbrk(-%l) failed\n", s, sz);
+    exit(1);
+  }
+}
+
+// does copyout() into a copy-on-write page give
+// the writing process its own copy?
+void
+cowcopyout(char *s)
+{
+  char *a;
+  int fds[2], pid, xstatus;
+
+  a = sbrk(PGSIZE);
+  memset(a, 'p', PGSIZE);
+  if(pipe(fds) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(read(fds[0], a, 10) != 10){
+      printf("%s: read failed\n", s);
+      exit(1);
+    }
+    if(a[0] != 'c' || a[9] != 'c' || a[10] != 'p')
+      exit(1);
+    exit(0);
+  }
+  if(write(fds[1], "cccccccccc", 10) != 10){
+    printf("%s: write failed\n", s);
+    exit(1);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(xstatus);
+  if(a[0] != 'p'){
+    printf("%s: child's read() changed the parent's memory\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// sbrk() should only reserve address space; a region larger than
+// physical memory can be grown as long as only a little of it is
+// touched. also checks that fork() copes with the untouched holes.
+void
+lazybig(char *s)
+{
+  int sz = 1024*1024*1024;
+  char *a, *b;
+  int pid, xstatus;
+
+  a = sbrk(sz);
+  if(a == (char*)-1){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(b = a; b < a + sz; b += sz / 64)
+    *b = 'z';
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(b = a; b < a + sz; b += sz / 64){
+      if(b[0] != 'z' || b[PGSIZE] != 0){
+        printf("%s: child saw wrong value\n", s);
+        exit(1);
+      }
+    }
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(xstatus);
+  if(a[sz-1] != 0){
+    printf("%s: untouched page not zero\n", s);
+    exit(1);
+  }
+  sbrk(-sz);
+}
+
+// system calls must fault in untouched sbrk() pages
+// on behalf of the process, for both copyin() and copyout().
+void
+lazycopy(char *s)
+{
+  char *a;
+  int fd, i;
+
+  a = sbrk(4*PGSIZE);
+  if(a == (char*)-1){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  fd = open("lazycopy", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  // copyin() from a page nobody has touched yet reads zeroes.
+  if(write(fd, a + PGSIZE, PGSIZE) != PGSIZE){
+    printf("%s: write from lazy page failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  a[2*PGSIZE] = 'x';
+  fd = open("lazycopy", O_RDONLY);
+  // copyout() into a page nobody has touched yet.
+  if(read(fd, a + 3*PGSIZE, PGSIZE) != PGSIZE){
+    printf("%s: read into lazy page failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("lazycopy");
+  for(i = 0; i < PGSIZE; i++){
+    if(a[3*PGSIZE+i] != 0){
+      printf("%s: wrong data\n", s);
+      exit(1);
+    }
+  }
+  if(a[2*PGSIZE] != 'x'){
+    printf("%s: lost a write\n", s);
+    exit(1);
+  }
+  sbrk(-4*PGSIZE);
+}
+
+// exec() reads the data segment in from the program file only
+// when it is touched. read() the program's own file straight into
+// data pages that have not been touched yet, so that the fault is
+// taken while readi() already holds the inode's lock.
+char execreadbuf[4*4096] = { 'r' };
+
+void
+execread(char *s)
+{
+  int fd, n;
+  char elf[4];
+
+  fd = open("usertests", O_RDONLY);
+  if(fd < 0){
+    printf("%s: cannot open usertests\n", s);
+    exit(1);
+  }
+  n = read(fd, execreadbuf + 2*4096, 2*4096);
+  close(fd);
+  if(n != 2*4096){
+    printf("%s: read returned %d\n", s, n);
+    exit(1);
+  }
+  elf[0] = 0x7f; elf[1] = 'E'; elf[2] = 'L'; elf[3] = 'F';
+  if(memcmp(execreadbuf + 2*4096, elf, 4) != 0 || execreadbuf[0] != 'r'){
+    printf("%s: wrong data\n", s);
+    exit(1);
+  }
+}
+
+// usertests is running, so its file can be neither written nor
+// truncated: exec() reads its pages in only when they are touched.
+// The write puts back the byte that is already there, in case it
+// succeeds.
+void
+textbusy(char *s)
+{
+  int fd;
+
+  fd = open("usertests", O_WRONLY);
+  if(fd < 0){
+    printf("%s: cannot open usertests\n", s);
+    exit(1);
+  }
+  if(write(fd, "\x7f", 1) != -1){
+    printf("%s: wrote to a running program\n", s);
+    exit(1);
+  }
+  close(fd);
+  if((fd = open("usertests", O_WRONLY|O_TRUNC)) >= 0){
+    printf("%s: truncated a running program\n", s);
+    exit(1);
+  }
+}
+
+// mmap() a file privately and shared: private writes stay in
+// memory, shared writes reach the file on munmap(), and bytes
+// past the end of the file read as zero.
+void
+mmapfile(char *s)
+{
+  int fd, i, n;
+  char *p, buf[16];
+  int sz = PGSIZE + PGSIZE/2;
+
+  fd = open("mmapfile", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < sz; i++)
+    if(write(fd, "a", 1) != 1){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+
+  p = mmap(0, 2*PGSIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if(p == MAP_FAILED){
+    printf("%s: mmap private failed\n", s);
+    exit(1);
+  }
+  if(p[0] != 'a' || p[sz-1] != 'a' || p[sz] != 0 || p[2*PGSIZE-1] != 0){
+    printf("%s: wrong private contents\n", s);
+    exit(1);
+  }
+  p[0] = 'p';
+  if(munmap(p, 2*PGSIZE) != 0){
+    printf("%s: munmap private failed\n", s);
+    exit(1);
+  }
+
+  p = mmap(0, sz, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == MAP_FAILED){
+    printf("%s: mmap shared failed\n", s);
+    exit(1);
+  }
+  if(p[0] != 'a'){
+    printf("%s: private write reached the file\n", s);
+    exit(1);
+  }
+  p[1] = 's';
+  p[PGSIZE+1] = 's';
+  // unmap the two pages one at a time.
+  if(munmap(p + PGSIZE, PGSIZE) != 0 || munmap(p, PGSIZE) != 0){
+    printf("%s: munmap shared failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  fd = open("mmapfile", O_RDONLY);
+  n = read(fd, buf, 2);
+  if(n != 2 || buf[0] != 'a' || buf[1] != 's'){
+    printf("%s: shared write lost\n", s);
+    exit(1);
+  }
+  p = mmap(0, sz, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(p == MAP_FAILED || p[PGSIZE+1] != 's' || p[PGSIZE+2] != 'a'){
+    printf("%s: second page not written back\n", s);
+    exit(1);
+  }
+  munmap(p, sz);
+  unlink("mmapfile");
+
+  // a read-only file cannot be mapped shared and writable.
+  fd = open("README", O_RDONLY);
+  if(mmap(0, PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0) != MAP_FAILED){
+    printf("%s: writable shared mapping of read-only file\n", s);
+    exit(1);
+  }
+  close(fd);
+}
+
+// a shared file mapping and read()/write() see each other's
+// changes at once, without munmap(), since both use the file's
+// cached pages.
+void
+mmapcoherent(char *s)
+{
+  int fd;
+  char *p, c;
+
+  fd = open("mmapcoh", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  if(write(fd, "aaaa", 4) != 4){
+    printf("%s: write failed\n", s);
+    exit(1);
+  }
+  p = mmap(0, PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == MAP_FAILED){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(p[0] != 'a'){
+    printf("%s: wrong contents\n", s);
+    exit(1);
+  }
+
+  if((fd = open("mmapcoh", O_RDWR)) < 0){
+    printf("%s: reopen failed\n", s);
+    exit(1);
+  }
+  if(write(fd, "b", 1) != 1 || p[0] != 'b'){
+    printf("%s: mapping missed a write()\n", s);
+    exit(1);
+  }
+  p[1] = 'c';
+  if(read(fd, &c, 1) != 1 || c != 'c'){
+    printf("%s: read() missed a store to the mapping\n", s);
+    exit(1);
+  }
+  close(fd);
+  munmap(p, PGSIZE);
+  unlink("mmapcoh");
+}
+
+// shared anonymous memory is shared with children; private
+// anonymous memory is copied. touching an unmapped page kills.
+void
+mmapfork(char *s)
+{
+  char *sh, *pv;
+  int pid, xstatus;
+
+  sh = mmap(0, 2*PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+  pv = mmap(0, PGSIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if(sh == MAP_FAILED || pv == MAP_FAILED){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+  pv[0] = 'p';
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    sh[0] = 'c';
+    sh[PGSIZE] = 'c';
+    pv[0] = 'c';
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(xstatus);
+  if(sh[0] != 'c' || sh[PGSIZE] != 'c'){
+    printf("%s: child's write to shared memory lost\n", s);
+    exit(1);
+  }
+  if(pv[0] != 'p'){
+    printf("%s: child's write to private memory seen\n", s);
+    exit(1);
+  }
+  if(munmap(sh, 2*PGSIZE) != 0 || munmap(pv, PGSIZE) != 0){
+    printf("%s: munmap failed\n", s);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid == 0){
+    sh[0] = 'x';
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != -1){
+    printf("%s: write to unmapped memory did not kill\n", s);
+    exit(1);
+  }
+}
+
+// file pages are cached: reads after an overwrite or a truncate
+// must see the new data, never a stale cached page.
+void
+pcachestale(char *s)
+{
+  enum { SZ = 16*1024 };
+  static char pbuf[SZ];
+  int fd, i, pass;
+
+  for(pass = 0; pass < 3; pass++){
+    fd = open("pcachestale", O_CREATE|O_RDWR|(pass == 2 ? O_TRUNC : 0));
+    if(fd < 0){
+      printf("%s: open failed\n", s);
+      exit(1);
+    }
+    if(pass == 1){
+      // overwrite the middle of the file.
+      memset(pbuf, 'b', 100);
+      if(read(fd, pbuf + 100, 5000) != 5000 || write(fd, pbuf, 100) != 100){
+        printf("%s: overwrite failed\n", s);
+        exit(1);
+      }
+    } else {
+      for(i = 0; i < SZ; i++)
+        pbuf[i] = 'a' + pass + i % 7;
+      if(write(fd, pbuf, SZ/(pass+1)) != SZ/(pass+1)){
+        printf("%s: write failed\n", s);
+        exit(1);
+      }
+    }
+    close(fd);
+
+    fd = open("pcachestale", O_RDONLY);
+    memset(pbuf, 0, SZ);
+    i = read(fd, pbuf, SZ);
+    close(fd);
+    if(i != (pass == 2 ? SZ/3 : SZ)){
+      printf("%s: pass %d: size %d\n", s, pass, i);
+      exit(1);
+    }
+    for(i = 0; i < (pass == 2 ? SZ/3 : SZ); i++){
+      char want = 'a' + (pass == 2 ? 2 : 0) + i % 7;
+      if(pass == 1 && i >= 5000 && i < 5100)
+        want = 'b';
+      if(pbuf[i] != want){
+        printf("%s: pass %d: stale byte at %d\n", s, pass, i);
+        exit(1);
+      }
+    }
+  }
+  unlink("pcachestale");
+}
+
+// two descriptors read the same large file sequentially at
+// different speeds, so each has readahead running ahead of where
+// the other is; both must see the right bytes.
+void
+readahead(char *s)
+{
+  enum { NB = 200, RSZ = 333 };
+  static char rbuf[3*BSIZE];
+  int fd, i, j, n, k, off[2], sz[2] = { RSZ, 2*BSIZE+1 };
+  int fds[2];
+
+  fd = open("readahead", O_CREATE|O_RDWR|O_TRUNC);
+  if(fd < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < NB; i++){
+    memset(rbuf, i, BSIZE);
+    if(write(fd, rbuf, BSIZE) != BSIZE){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+
+  for(k = 0; k < 2; k++){
+    fds[k] = open("readahead", O_RDONLY);
+    off[k] = 0;
+  }
+  while(off[0] < NB*BSIZE){
+    for(k = 0; k < 2; k++){
+      if(off[k] == NB*BSIZE)
+        continue;
+      if((n = read(fds[k], rbuf, sz[k])) <= 0){
+        printf("%s: short read at %d\n", s, off[k]);
+        exit(1);
+      }
+      for(j = 0; j < n; j++){
+        if(rbuf[j] != (char)((off[k] + j) / BSIZE)){
+          printf("%s: wrong byte at %d\n", s, off[k] + j);
+          exit(1);
+        }
+      }
+      off[k] += n;
+    }
+  }
+  for(k = 0; k < 2; k++){
+    if(read(fds[k], rbuf, 1) != 0){
+      printf("%s: read past end\n", s);
+      exit(1);
+    }
+    close(fds[k]);
+  }
+  unlink("readahead");
+}
+
+// a directory big enough to be hashed and to split its leaves
+// must still find every name, and be removable once empty.
+void
+hashdir(char *s)
+{
+  enum { N = 300 };
+  char name[8];
+  int i, fd;
+
+  if(mkdir("hd") != 0){
+    printf("%s: mkdir hd failed\n", s);
+    exit(1);
+  }
+  fd = open("hd/f", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create hd/f failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  name[0] = 'h';
+  name[1] = 'd';
+  name[2] = '/';
+  name[6] = 0;
+  for(i = 0; i < N; i++){
+    name[3] = '0' + i / 100;
+    name[4] = '0' + i / 10 % 10;
+    name[5] = '0' + i % 10;
+    if(link("hd/f", name) != 0){
+      printf("%s: link %s failed\n", s, name);
+      exit(1);
+    }
+  }
+  for(i = N - 1; i >= 0; i--){
+    name[3] = '0' + i / 100;
+    name[4] = '0' + i / 10 % 10;
+    name[5] = '0' + i % 10;
+    if((fd = open(name, O_RDONLY)) < 0){
+      printf("%s: open %s failed\n", s, name);
+      exit(1);
+    }
+    close(fd);
+  }
+  if((fd = open("hd/../hd/.", O_RDONLY)) < 0){
+    printf("%s: open hd/../hd/. failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  for(i = 0; i < N; i++){
+    name[3] = '0' + i / 100;
+    name[4] = '0' + i / 10 % 10;
+    name[5] = '0' + i % 10;
+    if(unlink(name) != 0){
+      printf("%s: unlink %s failed\n", s, name);
+      exit(1);
+    }
+  }
+  if(unlink("hd") == 0){
+    printf("%s: unlink non-empty hd succeeded\n", s);
+    exit(1);
+  }
+  unlink("hd/f");
+  if(unlink("hd") != 0){
+    printf("%s: unlink empty hd failed\n", s);
+    exit(1);
+  }
+}
+
+// names looked up before they exist, and names in a removed
+// directory, must not be remembered wrongly.
+void
+dcachestale(char *s)
+{
+  int fd;
+
+  if(open("dcs", O_RDONLY) >= 0){
+    printf("%s: dcs exists\n", s);
+    exit(1);
+  }
+  fd = open("dcs", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create dcs failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if((fd = open("dcs", O_RDONLY)) < 0){
+    printf("%s: dcs not found after create\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("dcs");
+
+  // look up dca/d/.. so that it is cached, then remove dca/d
+  // and make dcb/d, which likely gets the same inode.
+  if(mkdir("dca") != 0 || mkdir("dcb") != 0 || mkdir("dca/d") != 0){
+    printf("%s: mkdir failed\n", s);
+    exit(1);
+  }
+  fd = open("dca/m", O_CREATE|O_RDWR);
+  close(fd);
+  if((fd = open("dca/d/../m", O_RDONLY)) < 0){
+    printf("%s: open dca/d/../m failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(unlink("dca/d") != 0 || mkdir("dcb/d") != 0){
+    printf("%s: unlink dca/d or mkdir dcb/d failed\n", s);
+    exit(1);
+  }
+  if((fd = open("dcb/d/../m", O_RDONLY)) >= 0){
+    printf("%s: dcb/d/.. is still dca\n", s);
+    exit(1);
+  }
+  unlink("dcb/d");
+  unlink("dca/m");
+  unlink("dca");
+  unlink("dcb");
+}
+
+// sleep() must last at least as many ticks as asked for, with
+// other processes asleep for longer and shorter times, and a
+// long sleep must end when the process is killed.
+void
+sleeptime(char *s)
+{
+  int pid1, pid2, t0, t;
+
+  pid1 = fork();
+  if(pid1 == 0){
+    sleep(1000);
+    exit(0);
+  }
+  pid2 = fork();
+  if(pid2 == 0){
+    sleep(1);
+    exit(0);
+  }
+  if(pid1 < 0 || pid2 < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+
+  t0 = uptime();
+  sleep(3);
+  t = uptime() - t0;
+  if(t < 3){
+    printf("%s: sleep(3) took %d ticks\n", s, t);
+    exit(1);
+  }
+
+  kill(pid1);
+  wait(0);
+  wait(0);
+  if(uptime() - t0 > 100){
+    printf("%s: killed sleeper didn't wake\n", s);
+    exit(1);
+  }
+}
+
+// clock_gettime() must never go backwards, and nanosleep() must
+// sleep at least as long as asked, which can be far less than a
+// tick.
+void
+nanosleeptest(char *s)
+{
+  uint64 t0, t1, t;
+  int i;
+
+  if(clock_gettime(&t0) < 0){
+    printf("%s: clock_gettime failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 1000; i++){
+    clock_gettime(&t1);
+    if(t1 < t0){
+      printf("%s: clock went backwards\n", s);
+      exit(1);
+    }
+    t0 = t1;
+  }
+  if(sysclock_gettime((uint64*)0xffffffffffff) != -1){
+    printf("%s: clock_gettime to a bad address succeeded\n", s);
+    exit(1);
+  }
+
+  for(i = 0; i < 5; i++){
+    clock_gettime(&t0);
+    if(nanosleep(2000000) < 0){
+      printf("%s: nanosleep failed\n", s);
+      exit(1);
+    }
+    clock_gettime(&t1);
+    t = t1 - t0;
+    if(t < 2000000){
+      printf("%s: nanosleep(2000000) took %d ns\n", s, (int)t);
+      exit(1);
+    }
+  }
+}
+
+// getpid(), uptime() and clock_gettime() read the USYSCALL page
+// instead of making system calls; they must agree with the system
+// calls, in a child as well, and the page must be read-only.
+void
+usyscall(char *s)
+{
+  uint64 t0, t1, t2;
+  int pid, xstatus;
+
+  if(getpid() != sysgetpid()){
+    printf("%s: getpid() %d but sysgetpid() %d\n", s, getpid(), sysgetpid());
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    exit(getpid() == sysgetpid() ? 0 : 1);
+  }
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: child's getpid() is wrong\n", s);
+    exit(1);
+  }
+
+  clock_gettime(&t0);
+  sysclock_gettime(&t1);
+  clock_gettime(&t2);
+  if(t1 < t0 || t2 < t1){
+    printf("%s: clock_gettime() and sysclock_gettime() disagree\n", s);
+    exit(1);
+  }
+  if(uptime() < sysuptime() - 1 || uptime() > sysuptime() + 1){
+    printf("%s: uptime() and sysuptime() disagree\n", s);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid == 0){
+    *(int*)USYSCALL = 0;
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != -1){
+    printf("%s: wrote the USYSCALL page\n", s);
+    exit(1);
+  }
+}
+
+// nice() must accept only scheduler levels and existing
+// processes, return the old value, and be inherited by fork().
+void
+nicetest(char *s)
+{
+  int pid, xstatus;
+
+  if(nice(0, -1) != -1 || nice(0, NLEVEL) != -1){
+    printf("%s: nice accepted a bad level\n", s);
+    exit(1);
+  }
+  if(nice(0x7fffffff, 0) != -1){
+    printf("%s: nice of a non-existent pid succeeded\n", s);
+    exit(1);
+  }
+  if(nice(0, NLEVEL-1) != 0 || nice(getpid(), NLEVEL-1) != NLEVEL-1){
+    printf("%s: nice returned the wrong old value\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0)
+    exit(nice(0, 0));
+  wait(&xstatus);
+  if(nice(0, 0) != NLEVEL-1){
+    printf("%s: nice returned the wrong old value\n", s);
+    exit(1);
+  }
+  if(xstatus != NLEVEL-1){
+    printf("%s: child didn't inherit nice\n", s);
+    exit(1);
+  }
+}
+
 // regression test. test whether exec() leaks memory if one of the
 // arguments is invalid. the test passes if the kernel doesn't panic.
 void
@@ -2634,6 +3448,23 @@ struct test {
   {sbrkbugs, "sbrkbugs" },
   {sbrklast, "sbrklast"},
   {sbrk8000, "sbrk8000"},
+  {cowbig, "cowbig"},
+  {cowcopyout, "cowcopyout"},
+  {lazybig, "lazybig"},
+  {lazycopy, "lazycopy"},
+  {execread, "execread"},
+  {textbusy, "textbusy"},
+  {mmapfile, "mmapfile"},
+  {mmapcoherent, "mmapcoherent"},
+  {mmapfork, "mmapfork"},
+  {pcachestale, "pcachestale"},
+  {readahead, "readahead"},
+  {hashdir, "hashdir"},
+  {dcachestale, "dcachestale"},
+  {sleeptime, "sleeptime"},
+  {nanosleeptest, "nanosleep"},
+  {usyscall, "usyscall"},
+  {nicetest, "nice"},
   {badarg, "badarg" },
 
   { 0, 0},
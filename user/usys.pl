@@ -6,10 +6,13 @@ print "# generated by usys.pl - do not edit\n";
 
 print "#include \"kernel/syscall.h\"\n";
 
+# the stub is called label if given, for system calls that
+# ulib.c usually answers from the USYSCALL page instead.
 sub entry {
     my $name = shift;
-    print ".global $name\n";
-    print "${name}:\n";
+    my $label = shift || $name;
+    print ".global $label\n";
+    print "${label}:\n";
     # 将system call的number放入寄存器中
     print " li a7, SYS_${name}\n";
     # 这里的ecall是riscv中典型的陷阱调用代码
@@ -36,7 +39,12 @@ entry("link");
 entry("mkdir");
 entry("chdir");
 entry("dup");
-entry("getpid");
+entry("getpid", "sysgetpid");
 entry("sbrk");
 entry("sleep");
-entry("uptime");
+entry("uptime", "sysuptime");
+entry("mmap");
+entry("munmap");
+entry("clock_gettime", "sysclock_gettime");
+entry("nanosleep");
+entry("nice");
@@ -0,0 +1,76 @@
+// Measure reading the USYSCALL page against making system calls.
+//
+// usysbench times n calls each of getpid(), uptime() and
+// clock_gettime(), which ulib.c answers from the read-only page
+// the kernel maps at USYSCALL, and of the system calls
+// sysgetpid(), sysuptime() and sysclock_gettime() that give the
+// same answers through the trampoline.
+//
+//   usysbench [n]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+uint64 t0;
+volatile int sink;   // so that the calls aren't optimized away
+
+void
+start(void)
+{
+  clock_gettime(&t0);
+}
+
+void
+report(char *what, int n)
+{
+  uint64 t;
+
+  clock_gettime(&t);
+  t -= t0;
+  printf("usysbench: %d %s in %d us, %d ns each\n",
+         n, what, (int)(t / 1000), (int)(t / n));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, i;
+  uint64 ns;
+
+  n = 100000;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n <= 0){
+    printf("usage: usysbench [n]\n");
+    exit(1);
+  }
+
+  start();
+  for(i = 0; i < n; i++)
+    sink = getpid();
+  report("getpid()", n);
+  start();
+  for(i = 0; i < n; i++)
+    sink = sysgetpid();
+  report("sysgetpid()", n);
+
+  start();
+  for(i = 0; i < n; i++)
+    sink = uptime();
+  report("uptime()", n);
+  start();
+  for(i = 0; i < n; i++)
+    sink = sysuptime();
+  report("sysuptime()", n);
+
+  start();
+  for(i = 0; i < n; i++)
+    clock_gettime(&ns);
+  report("clock_gettime()", n);
+  start();
+  for(i = 0; i < n; i++)
+    sysclock_gettime(&ns);
+  report("sysclock_gettime()", n);
+  exit(0);
+}
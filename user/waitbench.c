@@ -0,0 +1,95 @@
+// Measure sleep/wakeup with many sleeping processes.
+//
+// waitbench starts nsleep processes (default 56, which with the
+// shell and the kernel's threads nearly fills NPROC = 64) that
+// each block reading a pipe of their own that never gets data. With them asleep it
+//  - times a byte bounced between two processes through two
+//    pipes, which is all wakeups and sleeps, and
+//  - counts how far a loop gets in a few ticks, so that time
+//    spent in the clock interrupt's wakeup shows up as a lower
+//    count.
+// Run it on kernels with and without hashed wait queues to
+// compare them, or with nsleep 0 for a baseline.
+//
+//   waitbench [nsleep]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define ROUNDS 5000
+#define SPINTICKS 20
+
+int
+main(int argc, char *argv[])
+{
+  int nsleep, i, t0, t, a[2], b[2], block[2], pids[64];
+  volatile uint64 n;
+  char c;
+
+  nsleep = 56;
+  if(argc > 1)
+    nsleep = atoi(argv[1]);
+  if(nsleep < 0 || nsleep > 64){
+    printf("usage: waitbench [nsleep]\n");
+    exit(1);
+  }
+
+  for(i = 0; i < nsleep; i++){
+    if((pids[i] = fork()) < 0){
+      printf("waitbench: only %d sleepers\n", i);
+      nsleep = i;
+      break;
+    }
+    if(pids[i] == 0){
+      if(pipe(block) < 0)
+        exit(1);
+      read(block[0], &c, 1);
+      exit(0);
+    }
+  }
+
+  if(pipe(a) < 0 || pipe(b) < 0){
+    printf("waitbench: pipe failed\n");
+    exit(1);
+  }
+  t0 = uptime();
+  if(fork() == 0){
+    for(i = 0; i < ROUNDS; i++){
+      if(read(a[0], &c, 1) != 1)
+        exit(1);
+      write(b[1], &c, 1);
+    }
+    exit(0);
+  }
+  for(i = 0; i < ROUNDS; i++){
+    write(a[1], &c, 1);
+    if(read(b[0], &c, 1) != 1){
+      printf("waitbench: ping-pong failed\n");
+      exit(1);
+    }
+  }
+  wait(0);
+  t = uptime() - t0;
+  printf("waitbench: %d sleepers: %d round trips in %d ticks", nsleep, ROUNDS, t);
+  if(t > 0)
+    printf(", %d per tick", ROUNDS / t);
+  printf("\n");
+
+  // start counting at a tick boundary.
+  t0 = uptime();
+  while(uptime() == t0)
+    ;
+  t0++;
+  for(n = 0; uptime() < t0 + SPINTICKS; )
+    for(i = 0; i < 1000; i++)
+      n++;
+  printf("waitbench: %d sleepers: %d thousand loops per tick\n",
+         nsleep, (int)(n / 1000 / SPINTICKS));
+
+  for(i = 0; i < nsleep; i++){
+    kill(pids[i]);
+    wait(0);
+  }
+  exit(0);
+}